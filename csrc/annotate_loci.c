@@ -1,9 +1,10 @@
 #include <unistd.h>
 #include "format.h"
 #include "log.h"
-#include "linestream.h"
+#include "linereader.h"
 #include "arg.h"
 #include "rofutil.h" 
+#include "gtfcache.h"
 
 #define AUTHOR_MAIL "roland.schmucki@roche.com"
 
@@ -20,6 +21,8 @@ typedef struct {
 
 static int verbose = 0;
 static Array loci; // of Locus
+static GtfCache cache = NULL; // used in place of loci if -loci is a cache
+static Array hits; // of int, genes of the cache at a position
 
 int orderLociByCoord (Locus *a,Locus *b)
 {
@@ -72,20 +75,47 @@ static int findLocusLoop (int pos,char *chr)
 }
 
 
+/* first gene of the cache overlapping chr:pos, -1 if none */
+static int findCacheLocus (int pos,char *chr)
+{
+  return gtfc_genesAt (cache,chr,pos,hits) > 0 ? arru (hits,0,int) : -1;
+}
+
+
+/* locus i, from the cache or from the loci table */
+static Locus *getLocus (int i,Locus *l)
+{
+  GtfcGene *currGene;
+
+  if (cache == NULL)
+    return arrp (loci,i,Locus);
+  currGene = &cache->genes[i];
+  l->chr = gtfc_string (cache,cache->chroms[currGene->chrom].name);
+  l->beg = currGene->start;
+  l->end = currGene->end;
+  l->str = currGene->strand;
+  l->gid = atoi (gtfc_string (cache,currGene->id));
+  l->sym = gtfc_string (cache,currGene->name);
+  l->desc = gtfc_string (cache,currGene->desc);
+  return l;
+}
+
+
 void print_gct (int ibeg, int iend, Texta it0)
 {
   int i;
   Locus *currLocus;
+  Locus l;
 
   printf ("%s\t", textItem (it0,0));
   if (ibeg > -1) {
-    currLocus = arrp (loci, ibeg, Locus);
+    currLocus = getLocus (ibeg, &l);
     printf ("%s", currLocus->sym);
   }
   if (iend > -1 && iend != ibeg) {
     if (ibeg > -1)
       printf ("|");
-      currLocus = arrp (loci, iend, Locus);
+      currLocus = getLocus (iend, &l);
       printf ("%s", currLocus->sym);
     }
     if (ibeg < 0 && iend < 0)
@@ -100,6 +130,7 @@ int print_topTable (int ibeg, int iend, char *line)
 {
   Locus *currLocus;
   Locus *currLocus1;
+  Locus l,l1;
 
   printf ("%s", line);
 
@@ -108,19 +139,19 @@ int print_topTable (int ibeg, int iend, char *line)
     return 0;
   }
   else if ((ibeg > -1 && iend < 0) || (ibeg == iend)) {
-    currLocus = arrp (loci, ibeg, Locus);
+    currLocus = getLocus (ibeg, &l);
     printf ("\t%d\t%s\t%s\n", 
             currLocus->gid, currLocus->sym, currLocus->desc);
     return 0;
   }
   else if (iend > -1 && ibeg < 0) {
-    currLocus = arrp (loci, iend, Locus);
+    currLocus = getLocus (iend, &l);
     printf ("\t%d\t%s\t%s\n",
             currLocus->gid, currLocus->sym, currLocus->desc);
     return 0;
   }
-  currLocus = arrp (loci, ibeg, Locus);
-  currLocus1 = arrp (loci, iend, Locus);
+  currLocus = getLocus (ibeg, &l);
+  currLocus1 = getLocus (iend, &l1);
   printf ("\t%d|%d\t%s|%s\t%s|%s\n", 
           currLocus->gid, currLocus1->gid,
 	  currLocus->sym, currLocus1->sym,
@@ -146,6 +177,7 @@ void usagef (int level)
 	 "\t                      format is gct or topTable then all subsequent columns sent to stdout \n"
          "\t-loci                 input file with loci information (required), tab-delimited format: \n"
 	 "\t                      CHR   BEGIN   END   STRAND   GENE   SYMBOL  DESCRIPTION \n"
+	 "\t                      or an annotation cache written by parse_gtf -compile \n"
 	 "\t-format gct|topTable  input file -i is in gct|topTable format (optional) \n"
 	 "\t-verbose              show more information (optional) \n"
 	 "\n"
@@ -163,13 +195,14 @@ int main (int argc,char *argv[])
   char *chr = NULL;
   char *line;
   Texta it, it0;
-  LineStream ls;
+  LineReader ls;
   Locus *currLocus;
   int beg;
   int end;
   int ibeg;
   int iend;
   int inputFormat;
+  Locus l;
 
   // set verbosity
   if (arg_present ("verbose"))
@@ -194,23 +227,30 @@ int main (int argc,char *argv[])
   chr19   58345183   58353492    -       1       A1BG    alpha-1-B glycoprotein
   chr12   9067708    9116229     -       2       A2M     alpha-2-macroglobulin
 */
-  ls = ls_createFromFile (arg_get ("loci"));
-  while (line = ls_nextLine (ls)) {
-    it = textFieldtokP (line,"\t");
-    if (arrayMax (it) < 7)
-      die("Wrong number of fields on line: %s (max %d)", line, arrayMax (it));
-    currLocus = arrayp (loci, arrayMax (loci), Locus);
-    currLocus->chr = hlr_strdup (textItem (it,0));
-    currLocus->beg = atoi (textItem (it,1));
-    currLocus->end = atoi (textItem (it,2));
-    currLocus->str = textItem (it,3)[0];
-    currLocus->gid = atoi (textItem (it,4));
-    currLocus->sym = hlr_strdup (textItem (it,5));
-    currLocus->desc = hlr_strdup (textItem (it,6));
-    textDestroy (it);
-  }    
-  ls_destroy (ls);
-  arraySort (loci,(ARRAYORDERF)orderLociByCoord);
+  if (gtfc_isCache (arg_get ("loci"))) {
+    // mapped and queried in place: genes are sorted by chromosome and start
+    cache = gtfc_open (arg_get ("loci"));
+    hits = arrayCreate (10,int);
+  }
+  else {
+    ls = lr_createFromFile (arg_get ("loci"));
+    while (line = lr_nextLine (ls)) {
+      it = textFieldtokP (line,"\t");
+      if (arrayMax (it) < 7)
+        die("Wrong number of fields on line: %s (max %d)", line, arrayMax (it));
+      currLocus = arrayp (loci, arrayMax (loci), Locus);
+      currLocus->chr = hlr_strdup (textItem (it,0));
+      currLocus->beg = atoi (textItem (it,1));
+      currLocus->end = atoi (textItem (it,2));
+      currLocus->str = textItem (it,3)[0];
+      currLocus->gid = atoi (textItem (it,4));
+      currLocus->sym = hlr_strdup (textItem (it,5));
+      currLocus->desc = hlr_strdup (textItem (it,6));
+      textDestroy (it);
+    }
+    lr_destroy (ls);
+    arraySort (loci,(ARRAYORDERF)orderLociByCoord);
+  }
   /*for (i=0;i<arrayMax (loci);i++) {
     currLocus = arrp (loci,i,Locus);
     printf ("# sorted by coordinates\t%s\t%d\t%s\t%d\t%d\t%c\t%s\n",
@@ -220,13 +260,13 @@ int main (int argc,char *argv[])
   }*/
 
   // parse input file and annotate
-  ls = ls_createFromFile (arg_get ("i"));
-  while (line = ls_nextLine (ls)) {
-    if (inputFormat == 1 && ls_lineCountGet (ls) < 4) { // GCT format
+  ls = lr_createFromFile (arg_get ("i"));
+  while (line = lr_nextLine (ls)) {
+    if (inputFormat == 1 && lr_lineCountGet (ls) < 4) { // GCT format
       puts (line);
       continue;
     }
-    if (inputFormat == 2 && ls_lineCountGet (ls) < 2) { // TopTable format
+    if (inputFormat == 2 && lr_lineCountGet (ls) < 2) { // TopTable format
       printf ("%s\tGENE\tSYMBOL\tDESCRIPTION\n",line);
       continue;
     }
@@ -245,15 +285,21 @@ int main (int argc,char *argv[])
     strReplace (&chr, textItem (it,0));
     beg = atoi (textItem (it,1));
     end = atoi (textItem (it,2));
-    ibeg = findLocus (beg,chr);
-    iend = findLocus (end,chr);
+    if (cache != NULL) {
+      ibeg = findCacheLocus (beg,chr);
+      iend = findCacheLocus (end,chr);
+    }
+    else {
+      ibeg = findLocus (beg,chr);
+      iend = findLocus (end,chr);
+    }
 
-    if (ibeg == -1) {
+    if (ibeg == -1 && cache == NULL) {
       ibeg = findLocusLoop (beg,chr);
       if (verbose == 1 && ibeg > -1)
         romsg ("# applied loop to find locus: chr=%s\tbeg=%d\tend=%d\t-->\tibeg=%d", chr, beg, end, ibeg);
     }
-    if (iend == -1) {
+    if (iend == -1 && cache == NULL) {
       iend = findLocusLoop (end,chr);
       if (verbose == 1 && iend > -1)
         romsg ("# applied loop to find locus: chr=%s\tbeg=%d\tend=%d\t-->\tiend=%d", chr, beg, end, iend);
@@ -266,13 +312,13 @@ int main (int argc,char *argv[])
     else {
       printf ("%s\t", textItem (it0,0));
       if (ibeg > -1) {
-        currLocus = arrp (loci, ibeg, Locus);
+        currLocus = getLocus (ibeg, &l);
         printf ("%s", currLocus->sym);
       }
       if (iend > -1 && iend != ibeg) {
         if (ibeg > -1)
           printf ("|");
-        currLocus = arrp (loci, iend, Locus);
+        currLocus = getLocus (iend, &l);
         printf ("%s", currLocus->sym);
       }
       if (ibeg < 0 && iend < 0)
@@ -282,7 +328,7 @@ int main (int argc,char *argv[])
     textDestroy (it);
     textDestroy (it0);
   }
-  ls_destroy (ls);
+  lr_destroy (ls);
 
   return 0;
 }
@@ -0,0 +1,420 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "log.h"
+#include "hlrmisc.h"
+#include "bgzf.h"
+
+#define BGZF_HEADER_SIZE 18
+
+
+static int readUInt16 (unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+
+static int checkHeader (unsigned char *h)
+{
+  return h[0] == 31 && h[1] == 139 && h[2] == 8 && (h[3] & 4) &&
+    readUInt16 (h+10) == 6 && h[12] == 'B' && h[13] == 'C' && readUInt16 (h+14) == 2;
+}
+
+
+/* 
+   Returns 1 if the file starts with a BGZF block header, 0 otherwise
+*/
+int bgzf_isBgzf (char *fileName)
+{
+  unsigned char h[BGZF_HEADER_SIZE];
+  FILE *fP = fopen (fileName,"rb");
+  int r = 0;
+
+  if (fP == NULL)
+    return 0;
+  if (fread (h,1,BGZF_HEADER_SIZE,fP) == BGZF_HEADER_SIZE)
+    r = checkHeader (h);
+  fclose (fP);
+  return r;
+}
+
+
+/*
+  Read and inflate the block starting at b->nextAddress.
+  Returns 0 at end of file
+*/
+static int readBlock (Bgzf b)
+{
+  unsigned char h[BGZF_HEADER_SIZE];
+  int blockSize,n;
+  z_stream zs;
+
+  if (fseeko (b->fP,b->nextAddress,SEEK_SET) != 0)
+    die ("bgzf: cannot seek to %lld",(long long)b->nextAddress);
+  n = fread (h,1,BGZF_HEADER_SIZE,b->fP);
+  if (n == 0)
+    return 0;
+  if (n != BGZF_HEADER_SIZE || !checkHeader (h))
+    die ("bgzf: invalid block header at offset %lld",(long long)b->nextAddress);
+  blockSize = readUInt16 (h+16) + 1;
+  n = blockSize - BGZF_HEADER_SIZE;
+  if (fread (b->cdata,1,n,b->fP) != n)
+    die ("bgzf: truncated block at offset %lld",(long long)b->nextAddress);
+
+  memset (&zs,0,sizeof (zs));
+  zs.next_in = b->cdata;
+  zs.avail_in = n - 8;
+  zs.next_out = b->udata;
+  zs.avail_out = BGZF_BLOCK_SIZE;
+  if (inflateInit2 (&zs,-15) != Z_OK)
+    die ("bgzf: inflateInit2 failed");
+  if (inflate (&zs,Z_FINISH) != Z_STREAM_END)
+    die ("bgzf: inflate failed at offset %lld",(long long)b->nextAddress);
+  inflateEnd (&zs);
+
+  b->blockAddress = b->nextAddress;
+  b->nextAddress += blockSize;
+  b->blockLength = zs.total_out;
+  b->blockOffset = 0;
+  return 1;
+}
+
+
+/*
+  Make sure there are unread bytes in the current block;
+  skips empty blocks (e.g. the EOF marker). Returns 0 at end of file
+*/
+static int fillBlock (Bgzf b)
+{
+  while (b->blockOffset >= b->blockLength) {
+    if (!readBlock (b))
+      return 0;
+  }
+  return 1;
+}
+
+
+Bgzf bgzf_openRead (char *fileName)
+{
+  Bgzf b = (Bgzf)hlr_calloc (1,sizeof (BgzfStruct));
+
+  if (!bgzf_isBgzf (fileName))
+    die ("bgzf: %s is not in BGZF format",fileName);
+  b->fP = hlr_fopenRead (fileName);
+  b->cdata = (unsigned char *)hlr_malloc (BGZF_BLOCK_SIZE);
+  b->udata = (unsigned char *)hlr_malloc (BGZF_BLOCK_SIZE);
+  b->lineSize = 1024;
+  b->line = (char *)hlr_malloc (b->lineSize);
+  return b;
+}
+
+
+void bgzf_close (Bgzf b)
+{
+  fclose (b->fP);
+  hlr_free (b->cdata);
+  hlr_free (b->udata);
+  hlr_free (b->line);
+  hlr_free (b);
+}
+
+
+/*
+  Virtual offset of the next byte to be read
+*/
+uint64_t bgzf_tell (Bgzf b)
+{
+  if (b->blockOffset >= b->blockLength)
+    fillBlock (b);
+  if (b->blockOffset >= b->blockLength) // end of file
+    return (uint64_t)b->nextAddress << 16;
+  return ((uint64_t)b->blockAddress << 16) | b->blockOffset;
+}
+
+
+/*
+  Positions the reader at virtual offset voffset; returns 0 if the
+  offset is beyond the end of the file or invalid
+*/
+int bgzf_seek (Bgzf b,uint64_t voffset)
+{
+  b->nextAddress = voffset >> 16;
+  b->blockLength = 0;
+  b->blockOffset = 0;
+  if (!readBlock (b))
+    return 0;
+  b->blockOffset = voffset & 0xFFFF;
+  return b->blockOffset <= b->blockLength;
+}
+
+
+/*
+  Returns the next line without the trailing newline or NULL at end of file.
+  The memory is owned by the reader and valid until the next call
+*/
+char *bgzf_getLine (Bgzf b)
+{
+  int len = 0;
+  int n;
+  unsigned char *start,*nl;
+
+  while (fillBlock (b)) {
+    start = b->udata + b->blockOffset;
+    n = b->blockLength - b->blockOffset;
+    nl = memchr (start,'\n',n);
+    if (nl != NULL)
+      n = nl - start;
+    if (len + n + 1 > b->lineSize) {
+      while (len + n + 1 > b->lineSize)
+        b->lineSize *= 2;
+      b->line = (char *)realloc (b->line,b->lineSize);
+      if (b->line == NULL)
+        die ("bgzf: out of memory");
+    }
+    memcpy (b->line+len,start,n);
+    len += n;
+    b->blockOffset += n;
+    if (nl != NULL) {
+      b->blockOffset++;
+      b->line[len] = '\0';
+      return b->line;
+    }
+  }
+  if (len == 0)
+    return NULL;
+  b->line[len] = '\0';
+  return b->line;
+}
+
+
+/* 
+   --------------------------------------------------------------
+   writer: the uncompressed data is cut into blocks of BGZF_MAX_DATA
+   bytes; a batch of blocks is deflated by the compression threads
+   while the next batch is filled, then written in input order
+   --------------------------------------------------------------
+*/
+
+static const unsigned char bgzfEof[28] = {
+  31,139,8,4,0,0,0,0,0,255,6,0,66,67,2,0,27,0,3,0,0,0,0,0,0,0,0,0
+};
+
+typedef struct {
+  BgzfWriter w;
+  BgzfBatch *b;
+  int t;
+} CompressJob;
+
+
+static void writeUInt16 (unsigned char *p,int v)
+{
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+}
+
+
+static void writeUInt32 (unsigned char *p,uint32_t v)
+{
+  writeUInt16 (p,v & 0xffff);
+  writeUInt16 (p+2,v >> 16);
+}
+
+
+/*
+  Deflate ulen bytes from udata into one BGZF block at cdata,
+  returns the block size
+*/
+static int compressBlock (unsigned char *udata,int ulen,unsigned char *cdata,int level)
+{
+  static const unsigned char header[BGZF_HEADER_SIZE] = {
+    31,139,8,4,0,0,0,0,0,255,6,0,66,67,2,0,0,0
+  };
+  z_stream zs;
+  int size;
+
+  memset (&zs,0,sizeof (zs));
+  if (deflateInit2 (&zs,level,Z_DEFLATED,-15,8,Z_DEFAULT_STRATEGY) != Z_OK)
+    die ("bgzf: deflateInit2 failed");
+  zs.next_in = udata;
+  zs.avail_in = ulen;
+  zs.next_out = cdata + BGZF_HEADER_SIZE;
+  zs.avail_out = BGZF_BLOCK_SIZE - BGZF_HEADER_SIZE - 8;
+  if (deflate (&zs,Z_FINISH) != Z_STREAM_END)
+    die ("bgzf: deflate failed");
+  size = BGZF_HEADER_SIZE + zs.total_out + 8;
+  deflateEnd (&zs);
+  memcpy (cdata,header,BGZF_HEADER_SIZE);
+  writeUInt16 (cdata+16,size-1);
+  writeUInt32 (cdata+size-8,crc32 (crc32 (0L,Z_NULL,0),udata,ulen));
+  writeUInt32 (cdata+size-4,ulen);
+  return size;
+}
+
+
+static void *compressWorker (void *arg)
+{
+  CompressJob *job = (CompressJob *)arg;
+  BgzfBatch *b = job->b;
+  int i;
+
+  for (i=job->t;i<b->n;i+=job->w->threads)
+    b->clen[i] = compressBlock (b->udata + (size_t)i*BGZF_MAX_DATA,b->ulen[i],
+                                b->cdata + (size_t)i*BGZF_BLOCK_SIZE,job->w->level);
+  return NULL;
+}
+
+
+static void writeAll (BgzfWriter w,unsigned char *p,int n)
+{
+  ssize_t k;
+
+  while (n > 0 && w->error == 0) {
+    k = write (w->fd,p,n);
+    if (k < 0) {
+      w->error = errno;
+      return;
+    }
+    p += k;
+    n -= k;
+    w->written += k;
+  }
+}
+
+
+/*
+  Wait for the compression threads of batch b and write its blocks
+*/
+static void finishBatch (BgzfWriter w,BgzfBatch *b)
+{
+  int i;
+
+  if (!b->running)
+    return;
+  for (i=0;i<w->threads;i++)
+    pthread_join (b->tids[i],NULL);
+  b->running = 0;
+  for (i=0;i<b->n;i++)
+    writeAll (w,b->cdata + (size_t)i*BGZF_BLOCK_SIZE,b->clen[i]);
+  b->n = 0;
+}
+
+
+static void startBatch (BgzfWriter w,BgzfBatch *b)
+{
+  CompressJob *job;
+  int i;
+
+  for (i=0;i<w->threads;i++) {
+    job = (CompressJob *)b->jobs + i;
+    job->w = w;
+    job->b = b;
+    job->t = i;
+    if (pthread_create (&b->tids[i],NULL,compressWorker,job) != 0)
+      die ("bgzf: cannot create thread");
+  }
+  b->running = 1;
+}
+
+
+/*
+  Write BGZF to the open file descriptor fd, compressing on 
+  threads threads with zlib compression level level
+*/
+BgzfWriter bgzf_openWrite (int fd,int threads,int level)
+{
+  BgzfWriter w = (BgzfWriter)hlr_calloc (1,sizeof (BgzfWriterStruct));
+  BgzfBatch *b;
+  int k;
+
+  if (threads < 1)
+    die ("bgzf: number of threads must be at least 1");
+  w->fd = fd;
+  w->threads = threads;
+  w->level = level;
+  w->batchSize = 4 * threads;
+  for (k=0;k<2;k++) {
+    b = &w->batch[k];
+    b->udata = (unsigned char *)hlr_malloc ((size_t)w->batchSize * BGZF_MAX_DATA);
+    b->cdata = (unsigned char *)hlr_malloc ((size_t)w->batchSize * BGZF_BLOCK_SIZE);
+    b->ulen = (int *)hlr_calloc (w->batchSize,sizeof (int));
+    b->clen = (int *)hlr_calloc (w->batchSize,sizeof (int));
+    b->tids = (pthread_t *)hlr_calloc (threads,sizeof (pthread_t));
+    b->jobs = hlr_calloc (threads,sizeof (CompressJob));
+  }
+  return w;
+}
+
+
+/*
+  Append len bytes. Returns 0 on success, -1 with errno set
+  if a previous write failed
+*/
+int bgzf_write (BgzfWriter w,void *data,int len)
+{
+  unsigned char *p = (unsigned char *)data;
+  BgzfBatch *b;
+  int n;
+
+  while (len > 0) {
+    b = &w->batch[w->curr];
+    n = BGZF_MAX_DATA - b->ulen[b->n];
+    if (n > len)
+      n = len;
+    memcpy (b->udata + (size_t)b->n*BGZF_MAX_DATA + b->ulen[b->n],p,n);
+    b->ulen[b->n] += n;
+    p += n;
+    len -= n;
+    if (b->ulen[b->n] == BGZF_MAX_DATA && ++b->n == w->batchSize) {
+      finishBatch (w,&w->batch[1-w->curr]);
+      startBatch (w,b);
+      w->curr = 1 - w->curr;
+      memset (w->batch[w->curr].ulen,0,w->batchSize * sizeof (int));
+    }
+  }
+  if (w->error != 0) {
+    errno = w->error;
+    return -1;
+  }
+  return 0;
+}
+
+
+/*
+  Flush all blocks, write the EOF marker and free the writer;
+  the file descriptor is not closed.
+  Returns the number of compressed bytes written or -1 with errno set
+*/
+long long bgzf_closeWrite (BgzfWriter w)
+{
+  BgzfBatch *b = &w->batch[w->curr];
+  long long written;
+  int k,error;
+
+  if (b->ulen[b->n] > 0)
+    b->n++;
+  finishBatch (w,&w->batch[1-w->curr]);
+  if (b->n > 0) {
+    startBatch (w,b);
+    finishBatch (w,b);
+  }
+  writeAll (w,(unsigned char *)bgzfEof,sizeof (bgzfEof));
+  written = w->written;
+  error = w->error;
+  for (k=0;k<2;k++) {
+    b = &w->batch[k];
+    hlr_free (b->udata);
+    hlr_free (b->cdata);
+    hlr_free (b->ulen);
+    hlr_free (b->clen);
+    hlr_free (b->tids);
+    hlr_free (b->jobs);
+  }
+  hlr_free (w);
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  return written;
+}
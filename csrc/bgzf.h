@@ -0,0 +1,66 @@
+#ifndef BGZF_H
+#define BGZF_H
+
+/*
+  Minimal reader and parallel writer for BGZF files (blocked gzip as
+  used by samtools/tabix).
+  A BGZF file is a series of gzip members of at most 64 kB uncompressed
+  data each; a position in the uncompressed stream is addressed by the
+  virtual offset (block file offset << 16 | offset within block).
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#define BGZF_BLOCK_SIZE 0x10000
+#define BGZF_MAX_DATA 0xff00    /* uncompressed bytes per written block */
+
+typedef struct {
+  FILE *fP;
+  off_t blockAddress;     /* file offset of the current block */
+  off_t nextAddress;      /* file offset of the next block */
+  int blockLength;        /* number of uncompressed bytes in current block */
+  int blockOffset;        /* read position within current block */
+  unsigned char *cdata;
+  unsigned char *udata;
+  char *line;             /* buffer returned by bgzf_getLine */
+  int lineSize;
+} BgzfStruct,*Bgzf;
+
+/* blocks compressed in parallel before they are written in order */
+typedef struct {
+  int n;                  /* number of filled blocks */
+  unsigned char *udata;   /* blocks of BGZF_MAX_DATA bytes */
+  int *ulen;
+  unsigned char *cdata;   /* blocks of BGZF_BLOCK_SIZE bytes */
+  int *clen;
+  pthread_t *tids;
+  void *jobs;             /* arguments of the compression threads */
+  int running;            /* compression threads started, not yet joined */
+} BgzfBatch;
+
+typedef struct {
+  int fd;
+  int threads;
+  int level;
+  int batchSize;          /* blocks per batch */
+  BgzfBatch batch[2];     /* one being filled while the other is compressed */
+  int curr;
+  long long written;      /* compressed bytes written to fd */
+  int error;              /* errno of the first write error */
+} BgzfWriterStruct,*BgzfWriter;
+
+extern int bgzf_isBgzf (char *fileName);
+extern Bgzf bgzf_openRead (char *fileName);
+extern void bgzf_close (Bgzf b);
+extern uint64_t bgzf_tell (Bgzf b);
+extern int bgzf_seek (Bgzf b,uint64_t voffset);
+extern char *bgzf_getLine (Bgzf b);
+
+extern BgzfWriter bgzf_openWrite (int fd,int threads,int level);
+extern int bgzf_write (BgzfWriter w,void *data,int len);
+extern long long bgzf_closeWrite (BgzfWriter w);
+
+#endif
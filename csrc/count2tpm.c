@@ -1,9 +1,11 @@
 #include <math.h>
 #include "format.h"
 #include "log.h"
-#include "linestream.h"
+#include "linereader.h"
 #include "arg.h"
 #include "array.h"
+#include "gtfcache.h"
+#include "gctb.h"
 
 #define STARTUP_MSG "N/A"
 #define PROG_VERSION "DEV"
@@ -25,6 +27,41 @@ static int orderItemsById (Item *a,Item *b)
 }
 
 
+static Array items;
+static Array sums;
+static int method;
+static int missing = 0,present = 0;
+
+
+/* adds the read counts of one GCT row (NaN counted as 0) */
+static void addRow (char *id,char *desc,double *counts,int nsamples)
+{
+  Item oneItem;
+  Item *currItem;
+  int index,i;
+  float x;
+
+  oneItem.id = id;
+  if (!arrayFind (items,&oneItem,&index,(ARRAYORDERF)orderItemsById)) {
+    missing++;
+    warn ("Missing gene %s %s",id,desc);
+    return;
+  }
+  present++;
+  currItem = arrp (items,index,Item);
+  currItem->flag = 1;
+  currItem->desc = hlr_strdup (desc);
+  currItem->norm = arrayCreate (nsamples,float);
+  for (i=0;i<nsamples;i++) {
+    x = isnan (counts[i]) ? 0 : (float)(int)counts[i];
+    if (method == 0) // TPM
+      x = x / currItem->len*1.e-3;
+    array (currItem->norm,arrayMax (currItem->norm),float) = x;
+    arru (sums,i,float) += x*1.e-6;
+  }
+}
+
+
 void usagef (int level)
 {
   romsg ("Description: \n"
@@ -34,14 +71,16 @@ void usagef (int level)
 	 "https://haroldpimentel.wordpress.com/2014/05/08/what-the-fpkm-a-review-rna-seq-expression-units/ \n"
 	 "Note that NaN are output as zero 0. \n"
 	 "\n"
-         "Usage: %s -i GCT-file -l Length-file [-cpm|rpkm|tpm] [-log2|log10] [-col INT] [-digits INT] \n"
+         "Usage: %s -i GCT-file -l Length-file [-cpm|rpkm|tpm] [-log2|log10] [-col INT] [-digits INT] [-gctb FILE] \n"
 	 "\n"
 	 "\n"
 	 "Mandatory input parameters: \n"
 	 "\n"
-	 "\t-g     GCT file with read counts per gene (unique gene identifier in 1st column): \n"
+	 "\t-g     GCT file with read counts per gene (unique gene identifier in 1st column), \n"
+	 "\t       text or binary (.gctb, see gct2gctb) \n"
 	 "\t-l     tab-delimited file with gene identifier in 1st and gene length in \n"
-	 "\t       2nd columns, respectively. \n"
+	 "\t       2nd columns, respectively, or an annotation cache written by \n"
+	 "\t       parse_gtf -compile (length of the union of the exons per gene). \n"
          "\t       These files can be found in the corresponding genome annotation folders, \n"
 	 "\t       e.g. for human in folder /<path to genomes folder>/hg38/gtf/refseq/ \n"
 	 "\n"
@@ -56,6 +95,8 @@ void usagef (int level)
          "\t-col     if input length file contains several columns, then specify \n"
 	 "\t         the column number with this index (default last column) \n"
 	 "\t-digits  number of digits after comma for output (default %d) \n"
+	 "\t-gctb    write the normalized values as float32 binary GCT to this file \n"
+	 "\t         instead of text to stdout \n"
 	 "\n"
 	 "\n"
          " Report bugs and feedback to %s \n",
@@ -67,23 +108,26 @@ void usagef (int level)
 int main (int argc,char *argv[])
 {
 
-  if (arg_init (argc,argv,"tpm,0 rpkm,0 cpm,0 log2,0 log10,0 col,1 digits,1","g l",usagef) != argc)
+  if (arg_init (argc,argv,"tpm,0 rpkm,0 cpm,0 log2,0 log10,0 col,1 digits,1 gctb,1","g l",usagef) != argc)
     die ("wrong number of arguments; invoke program without params for help");
 
   Texta it;
-  LineStream ls;
-  Array items;
+  LineReader ls;
   char *line;
   Item *currItem;
-  Item oneItem;
-  int index,i,j,nsamples,method;
+  int index,i,j,nsamples;
   float x;
   float y;
   items = arrayCreate (100,Item);
-  Array sums;
-  int missing = 0,present = 0;
   char *headerLine;
   int digits = DIGITS;
+  GtfCache cache;
+  GtfcGene *currGene;
+  Gctb gctb;
+  GctbWriter out = NULL;
+  Array counts;
+  double *values;
+  Stringa header;
 
   if (arg_present ("cpm"))
     method = 1;
@@ -99,82 +143,110 @@ int main (int argc,char *argv[])
 
 
   // read file with gene lengths
-  ls = ls_createFromFile (arg_get ("l"));
-  while (line = ls_nextLine (ls)) {
-    it = textFieldtokP(line,"\t");
+  if (gtfc_isCache (arg_get ("l"))) {
+    cache = gtfc_open (arg_get ("l"));
+    for (i=0;i<gtfc_nGenes (cache);i++) {
+      currGene = &cache->genes[i];
+      if (currGene->exonLength == 0)
+        continue;
+      currItem = arrayp (items,arrayMax (items),Item);
+      currItem->id = gtfc_string (cache,currGene->id);
+      currItem->len = currGene->exonLength;
+      currItem->flag = 0;
+    }
+  }
+  else {
+    ls = lr_createFromFile (arg_get ("l"));
+    while (line = lr_nextLine (ls)) {
+      it = textFieldtokP(line,"\t");
 //    it = textStrtokP (line,"\t");
-    currItem = arrayp (items,arrayMax (items),Item);
-    currItem->id = hlr_strdup (textItem (it,0));
-    if (arg_present ("col")) {
-      index = atoi (arg_get ("col")) - 1;
-      if (index < 1 || index+1 > arrayMax (it))
-        die ("given column index is invalid. Abort!");
-      currItem->len = atoi(textItem (it,index));
+      currItem = arrayp (items,arrayMax (items),Item);
+      currItem->id = hlr_strdup (textItem (it,0));
+      if (arg_present ("col")) {
+        index = atoi (arg_get ("col")) - 1;
+        if (index < 1 || index+1 > arrayMax (it))
+          die ("given column index is invalid. Abort!");
+        currItem->len = atoi(textItem (it,index));
+      }
+      else
+        currItem->len = atoi(textItem (it,arrayMax (it)-1));
+      currItem->flag = 0;
+      textDestroy (it);
     }
-    else
-      currItem->len = atoi(textItem (it,arrayMax (it)-1));
-    currItem->flag = 0;
-    textDestroy (it);
+    lr_destroy (ls);
   }
-  ls_destroy (ls);
   arraySort (items,(ARRAYORDERF)orderItemsById);
   
   // read gct file with read counts
-  ls = ls_createFromFile (arg_get ("g"));
-  while (line = ls_nextLine (ls)) {
-    if (ls_lineCountGet (ls) < 2)
-      continue;
-    else if (ls_lineCountGet (ls) == 2) {
-      it = textFieldtokP(line,"\t");
-      //it = textStrtokP (line,"\t");
-      if (arrayMax (it) != 2)
-        die ("Error in gct file header: head line #2 does not have 2 columns.");
-      nsamples = atoi (textItem (it,1));
-      textDestroy (it);
-      sums = arrayCreate (nsamples,float);
-      for (i=0;i<nsamples;i++)
-        array (sums,arrayMax (sums),float) = 0.;
-      continue;
+  if (gctb_isGctb (arg_get ("g"))) {
+    gctb = gctb_open (arg_get ("g"));
+    nsamples = gctb_numCols (gctb);
+    sums = arrayCreate (nsamples,float);
+    for (i=0;i<nsamples;i++)
+      array (sums,arrayMax (sums),float) = 0.;
+    header = stringCreate (1000);
+    stringCpy (header,"Name\tDescription");
+    for (j=0;j<nsamples;j++)
+      stringAppendf (header,"\t%s",gctb_colName (gctb,j));
+    headerLine = string (header);
+    values = hlr_malloc ((nsamples + 1) * sizeof (double));
+    for (i=0;i<gctb_numRows (gctb);i++) {
+      gctb_row (gctb,i,values);
+      addRow (gctb_rowId (gctb,i),gctb_rowDesc (gctb,i),values,nsamples);
     }
-    else if (ls_lineCountGet (ls) == 3)  {
-      headerLine = hlr_strdup (line);
-      continue;
-    }
-    //it = textStrtokP (line,"\t");
-    it = textFieldtokP(line,"\t");
-    if (nsamples != arrayMax (it)-2)
-      die ("inconsistency on line %s",line);
-    oneItem.id = textItem (it,0);
-    if (arrayFind (items,&oneItem,&index,(ARRAYORDERF)orderItemsById)) {
-      present++;
-      currItem = arrp (items,index,Item);
-      currItem->flag = 1;
-      currItem->desc = hlr_strdup (textItem (it,1));
-      currItem->norm = arrayCreate (nsamples,float);
-      for (i=2;i<arrayMax (it);i++) {        
-        if (method == 1 || method == 2) // CPM or RPKM
-          x = (float) atoi (textItem (it,i));
-        else // TPM
-          x = (float) atoi (textItem (it,i)) / currItem->len*1.e-3;
-        array (currItem->norm,arrayMax (currItem->norm),float) = x;
-        arru (sums,i-2,float) += x*1.e-6;
+    hlr_free (values);
+    gctb_close (gctb);
+  }
+  else {
+    counts = arrayCreate (100,double);
+    ls = lr_createFromFile (arg_get ("g"));
+    while (line = lr_nextLine (ls)) {
+      if (lr_lineCountGet (ls) < 2)
+        continue;
+      else if (lr_lineCountGet (ls) == 2) {
+        it = textFieldtokP(line,"\t");
+        if (arrayMax (it) != 2)
+          die ("Error in gct file header: head line #2 does not have 2 columns.");
+        nsamples = atoi (textItem (it,1));
+        textDestroy (it);
+        sums = arrayCreate (nsamples,float);
+        for (i=0;i<nsamples;i++)
+          array (sums,arrayMax (sums),float) = 0.;
+        continue;
       }
+      else if (lr_lineCountGet (ls) == 3)  {
+        headerLine = hlr_strdup (line);
+        continue;
+      }
+      it = textFieldtokP(line,"\t");
+      if (nsamples != arrayMax (it)-2)
+        die ("inconsistency on line %s",line);
+      arrayClear (counts);
+      for (i=2;i<arrayMax (it);i++)
+        array (counts,arrayMax (counts),double) = atoi (textItem (it,i));
+      addRow (textItem (it,0),textItem (it,1),arrp (counts,0,double),nsamples);
+      textDestroy (it);
     }
-    else {
-      missing++;
-      warn ("Missing gene %s %s",oneItem.id,textItem (it,1));
-    }
-    textDestroy (it);
+    lr_destroy (ls);
   }
-  ls_destroy (ls);
 
 
   // output normalized read counts
-  printf ("#1.2\n%d\t%d\n%s\n",present,nsamples,headerLine);
+  if (arg_present ("gctb")) {
+    out = gctb_createWriter (arg_get ("gctb"),present,nsamples,GCTB_FLOAT32,GCTB_ROW_MAJOR);
+    it = textFieldtokP (headerLine,"\t");
+    for (j=0;j<nsamples && j+2<arrayMax (it);j++)
+      gctb_setColName (out,j,textItem (it,j+2));
+    textDestroy (it);
+  }
+  else
+    printf ("#1.2\n%d\t%d\n%s\n",present,nsamples,headerLine);
+  values = hlr_malloc ((nsamples + 1) * sizeof (double));
   for (i=0;i<arrayMax (items);i++) {
     currItem = arrp (items,i,Item);
     if (currItem->flag == 1) {
-      printf ("%s\t%s",currItem->id,currItem->desc);
+      if (out == NULL)
+        printf ("%s\t%s",currItem->id,currItem->desc);
       for (j=0;j<nsamples;j++) {
         if (method == 1) // CPM
           x = arru (currItem->norm,j,float) / arru (sums,j,float); 
@@ -191,11 +263,19 @@ int main (int argc,char *argv[])
 	if (isnan(y))
 	  y = 0.;
 	//printf ("\t%.3f",y);
-	printf("\t%.*f", digits, y);
+        if (out != NULL)
+          values[j] = y;
+        else
+	  printf("\t%.*f", digits, y);
       }
-      printf ("\n");
+      if (out != NULL)
+        gctb_addRow (out,currItem->id,currItem->desc,values);
+      else
+        printf ("\n");
     }
   }
+  if (out != NULL)
+    gctb_finish (out);
   if (missing > 0)
     warn ("%d genes present in the GCT file are missing in the gene length file.",missing);
 
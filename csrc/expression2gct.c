@@ -9,7 +9,7 @@
 #include <ctype.h>
 #include "format.h"
 #include "log.h"
-#include "linestream.h"
+#include "linereader.h"
 #include "arg.h"
 #include "rofutil.h"
 
@@ -99,7 +99,7 @@ int main(int argc, char *argv[])
   Texta infiles;
   int i,k;
   int sampleNumber;
-  LineStream ls;
+  LineReader ls;
   char *line;
   Array signals;
   Array probes;
@@ -137,8 +137,8 @@ int main(int argc, char *argv[])
   /* sample names from input file */
   if (arrayMax (it) == 1 && hlr_fileSizeGet (arg_get ("infile")) && 
       !strEndsWith (arg_get ("infile"),".expression")) {
-    ls = ls_createFromFile (arg_get ("infile"));
-    while (line = ls_nextLine (ls)) {
+    ls = lr_createFromFile (arg_get ("infile"));
+    while (line = lr_nextLine (ls)) {
       it2 = textStrtokP (line,"\t");
       textAdd (infiles,textItem (it2,0));
       if (arrayMax (it2) > 1)
@@ -150,7 +150,7 @@ int main(int argc, char *argv[])
         stringChop (str,11);
       textAdd (samples,string (str));
     }
-    ls_destroy (ls);
+    lr_destroy (ls);
   }
   else {
     /* sample names from command line*/
@@ -186,8 +186,8 @@ int main(int argc, char *argv[])
     newprobes = 0;
     knownprobes = 0;
     printf ("# %s\t%s",textItem (samples,isample),textItem (infiles,isample));
-    ls = ls_createFromFile (textItem (infiles,isample));
-    while (line = ls_nextLine (ls)) {
+    ls = lr_createFromFile (textItem (infiles,isample));
+    while (line = lr_nextLine (ls)) {
       if (strStartsWith (line,"Gene"))
 	continue;
       it = textStrtokP (line,"\t");
@@ -274,7 +274,7 @@ int main(int argc, char *argv[])
       }
       textDestroy (it);
     }
-    ls_destroy (ls);
+    lr_destroy (ls);
     arraySort (signals,(ARRAYORDERF)orderSignalsByProbe);
     printf ("\t%d\t%d\t%d",knownprobes,newprobes,arrayMax (signals));
     printf ("\n");
@@ -1,12 +1,45 @@
+#include <stdint.h>
+#include <sys/stat.h>
 #include "format.h"
 #include "log.h"
-#include "linestream.h"
+#include "linereader.h"
 #include "arg.h"
+#include "bgzf.h"
+#include "strhash.h"
 
 #define AUTHOR_MAIL "roland.schmucki@roche.com"
+#define BIN_BUFFER_SIZE 1048576
+#define BIN_BUFFER_MIN 65536
+#define BIN_BUFFER_TOTAL 67108864
+#define INDEX_SUFFIX ".idx"
+#define INDEX_SCAN_SIZE 65536
+#define INDEX_MAGIC "#extract_sequence-index-2"
 
 int verbose = 0;
 
+typedef struct {
+  char *id;
+  int bin;
+} Item;
+
+static int orderItemsById (Item *a,Item *b)
+{
+  return strcmp (a->id,b->id);
+}
+
+typedef struct {
+  uint64_t offset;
+  int bin;
+  char *id;
+} Hit;
+
+static int orderHitsByOffset (Hit *a,Hit *b)
+{
+  if (a->offset < b->offset)
+    return -1;
+  return a->offset > b->offset;
+}
+
 void usagef (int level)
 {
   romsg ("Description: \n"
@@ -14,7 +47,9 @@ void usagef (int level)
          "Extract from an input fasta or fastq file sequences by ids from another input file.\n"
 	 "\n"
          "Usage: %s [-verbose] [-delimiter='. TAB'] [-useEntireIdLine] \n"
-         "          [-quick] [-not] -ids ids_file -fasta|fastq fasta_file \n"
+         "          [-quick] [-not] [-bins [-bin-prefix STR] [-unassigned FILE]] \n"
+         "          -ids ids_file -fasta|fastq fasta_file \n"
+         "       %s -index [-delimiter='. TAB'] [-useEntireIdLine] -fasta|fastq fasta_file \n"
 	 "\n" 
 	 "Mandatory parameters: \n"
 	 "\n"
@@ -29,26 +64,350 @@ void usagef (int level)
 	 "\t  -quick            stop search after the first match \n"
 	 "\t  -not              inverse the search, ie output sequences that are \n"
 	 "\t                    not in the ids file \n"
+	 "\t  -bins             use column 2 of the ids file as bin name and write \n"
+	 "\t                    the sequences of each bin in one pass into the file \n"
+	 "\t                    <bin-prefix><bin>.fasta|fastq instead of stdout \n"
+	 "\t  -bin-prefix       prefix for the bin output files, e.g. path, default none \n"
+	 "\t  -unassigned       with -bins, write sequences not in the ids file to this file \n"
+	 "\t                    (reads the whole input, so not with -quick) \n"
+	 "\t  -index            build the sidecar index <fasta|fastq file>%s which maps \n"
+	 "\t                    every sequence id to its byte offset (plain input) or to \n"
+	 "\t                    its BGZF virtual offset (bgzip compressed input) and exit \n"
+	 "\t                    the index records size, modification time and inode of \n"
+	 "\t                    the file and must be rebuilt whenever the file changes \n"
+	 "\t  -use-index        look up the ids in the sidecar index and seek directly to \n"
+	 "\t                    the sequences instead of reading the entire file; use the \n"
+	 "\t                    same -delimiter/-useEntireIdLine as for building the index \n"
 	 "\t  -verbose          output additional information \n"
 	 "\n"
 	 "\n"
          "Report bugs and feedback to %s \n",
-         arg_getProgName (), AUTHOR_MAIL);
+         arg_getProgName (), arg_getProgName (), INDEX_SUFFIX, AUTHOR_MAIL);
+}
+
+
+/*
+  Sequence id of a fasta header or fastq read name line,
+  same rules as used for searching (see main)
+*/
+static char *recordId (char *line,int isFastq,Stringa delim)
+{
+  static char *id = NULL;
+  Texta it;
+
+  if (!isFastq && arg_present ("useEntireIdLine")) {
+    strReplace (&id,line);
+    return id;
+  }
+  if (isFastq)
+    it = textFieldtokP (line," ");
+  else if (delim != NULL)
+    it = textFieldtokP (line,string (delim));
+  else
+    it = textFieldtokP (line," \t");
+  strReplace (&id,textItem (it,0)[0] == '@' || textItem (it,0)[0] == '>' ?
+              textItem (it,0)+1 : textItem (it,0));
+  textDestroy (it);
+  return id;
+}
+
+
+/*
+  Write the sidecar index: a header line with the size, modification
+  time (with nanoseconds) and inode of seqFile, then one line
+  "id TAB offset" per sequence, sorted by id (plain byte order) to
+  allow a binary search on the file
+*/
+static void buildIndex (char *seqFile,int isFastq,Stringa delim)
+{
+  Stringa str = stringCreate (100);
+  FILE *fP;
+  FILE *inP = NULL;
+  Bgzf bgzf = NULL;
+  char *line = NULL;
+  size_t lineSize = 0;
+  ssize_t n;
+  uint64_t offset = 0;
+  uint64_t lineOffset;
+  long long count = 0;
+  long long nrec = 0;
+  struct stat st;
+
+  if (stat (seqFile,&st) != 0)
+    die ("cannot stat %s",seqFile);
+  if (bgzf_isBgzf (seqFile))
+    bgzf = bgzf_openRead (seqFile);
+  else if (strEndsWith (seqFile,".gz"))
+    die ("%s is gzipped but not BGZF compressed; recompress with bgzip to build an index",
+         seqFile);
+  else
+    inP = hlr_fopenRead (seqFile);
+
+  stringPrintf (str,"%s%s",seqFile,INDEX_SUFFIX);
+  fP = hlr_fopenWrite (string (str));
+  fprintf (fP,"%s\t%lld\t%lld\t%ld\t%llu\n",INDEX_MAGIC,(long long)st.st_size,
+           (long long)st.st_mtim.tv_sec,(long)st.st_mtim.tv_nsec,(unsigned long long)st.st_ino);
+  if (fclose (fP) != 0)
+    die ("error writing %s",string (str));
+  stringPrintf (str,"LC_ALL=C sort -t \"$(printf '\\t')\" -k1,1 >> %s%s",seqFile,INDEX_SUFFIX);
+  fP = popen (string (str),"w");
+  if (fP == NULL)
+    die ("cannot start %s",string (str));
+  for (;;) {
+    if (bgzf != NULL) {
+      lineOffset = bgzf_tell (bgzf);
+      if ((line = bgzf_getLine (bgzf)) == NULL)
+        break;
+    }
+    else {
+      lineOffset = offset;
+      if ((n = getline (&line,&lineSize,inP)) < 0)
+        break;
+      offset += n;
+      if (n > 0 && line[n-1] == '\n')
+        line[n-1] = '\0';
+    }
+    if ((isFastq && count++ % 4 == 0) || (!isFastq && line[0] == '>')) {
+      fprintf (fP,"%s\t%llu\n",recordId (line,isFastq,delim),(unsigned long long)lineOffset);
+      nrec++;
+    }
+  }
+  if (pclose (fP) != 0)
+    die ("sorting of index %s%s failed",seqFile,INDEX_SUFFIX);
+  if (bgzf != NULL)
+    bgzf_close (bgzf);
+  else {
+    fclose (inP);
+    free (line);
+  }
+  if (verbose)
+    printf ("#INFO %lld sequences indexed in %s%s\n",nrec,seqFile,INDEX_SUFFIX);
+  stringDestroy (str);
+}
+
+
+/*
+  Read the line starting at file position pos of the index file
+  and return its length including the newline, 0 at end of file
+*/
+static int readIndexLine (FILE *fP,off_t pos,char **line,size_t *lineSize)
+{
+  ssize_t n;
+
+  if (fseeko (fP,pos,SEEK_SET) != 0)
+    die ("cannot seek in index file");
+  n = getline (line,lineSize,fP);
+  if (n <= 0)
+    return 0;
+  return n;
+}
+
+
+static int compareIndexLine (char *line,char *id)
+{
+  int i;
+
+  for (i=0;id[i] != '\0';i++) {
+    if (line[i] != id[i])
+      return (unsigned char)line[i] == '\t' ? -1 : (unsigned char)line[i] - (unsigned char)id[i];
+  }
+  return line[i] == '\t' ? 0 : 1;
+}
+
+
+/*
+  Binary search for id in the sorted lines from start to size of the
+  index file, add the offsets of all matching lines to hits
+*/
+static int findInIndex (FILE *fP,off_t start,off_t size,char *id,int bin,Array hits)
+{
+  static char *line = NULL;
+  static size_t lineSize = 0;
+  off_t lo = start,hi = size,mid,pos;
+  int n,cmp,found = 0;
+  Hit *currHit;
+
+  /* narrow [lo,hi] to a small range of lines that contains the first id >= target */
+  while (hi - lo > INDEX_SCAN_SIZE) {
+    mid = lo + (hi-lo)/2;
+    n = readIndexLine (fP,mid-1,&line,&lineSize); // skip to the next line start
+    pos = mid - 1 + n;
+    if (pos >= hi)
+      break;
+    n = readIndexLine (fP,pos,&line,&lineSize);
+    if (compareIndexLine (line,id) < 0)
+      lo = pos + n;
+    else
+      hi = pos;
+  }
+  pos = lo;
+  while (pos <= hi && (n = readIndexLine (fP,pos,&line,&lineSize)) > 0) {
+    cmp = compareIndexLine (line,id);
+    if (cmp > 0)
+      break;
+    if (cmp == 0) {
+      currHit = arrayp (hits,arrayMax (hits),Hit);
+      currHit->offset = strtoull (strchr (line,'\t')+1,NULL,10);
+      currHit->bin = bin;
+      currHit->id = id;
+      found++;
+      hi = pos + n; // matching lines are adjacent
+    }
+    pos += n;
+  }
+  return found;
+}
+
+
+/*
+  Reads the header line of index file fP and returns its length; dies
+  if the index does not describe the current seqFile
+*/
+static off_t checkIndex (FILE *fP,char *idxFile,char *seqFile)
+{
+  char *line = NULL;
+  size_t lineSize = 0;
+  ssize_t n;
+  long long size,mtime;
+  long nsec;
+  unsigned long long inode;
+  struct stat st;
+
+  if (stat (seqFile,&st) != 0)
+    die ("cannot stat %s",seqFile);
+  n = getline (&line,&lineSize,fP);
+  if (n <= 0 || strncmp (line,INDEX_MAGIC "\t",strlen (INDEX_MAGIC) + 1) != 0 ||
+      sscanf (line + strlen (INDEX_MAGIC),"%lld %lld %ld %llu",&size,&mtime,&nsec,&inode) != 4)
+    die ("index %s is from an older version; rebuild it with -index",idxFile);
+  if (size != st.st_size || mtime != st.st_mtim.tv_sec || nsec != st.st_mtim.tv_nsec ||
+      inode != st.st_ino)
+    die ("index %s does not match %s (size, modification time or inode changed); "
+         "rebuild it with -index",idxFile,seqFile);
+  free (line);
+  return n;
+}
+
+
+/*
+  Look up all ids in the sidecar index, sort the offsets and
+  output the sequences by seeking directly to them; dies if the
+  record at an offset is not the one indexed
+*/
+static void extractByIndex (char *seqFile,int isFastq,Stringa delim,Array ids,Array binFiles)
+{
+  Stringa str = stringCreate (100);
+  Array hits = arrayCreate (arrayMax (ids),Hit);
+  Hit *currHit;
+  Item *currItem;
+  FILE *fP;
+  FILE *inP = NULL;
+  FILE *outFp;
+  Bgzf bgzf = NULL;
+  struct stat idxStat;
+  char *line = NULL;
+  size_t lineSize = 0;
+  ssize_t n;
+  off_t start;
+  int i,k;
+
+  stringPrintf (str,"%s%s",seqFile,INDEX_SUFFIX);
+  if (stat (string (str),&idxStat) != 0)
+    die ("index %s not found; build it first with -index",string (str));
+
+  fP = hlr_fopenRead (string (str));
+  start = checkIndex (fP,string (str),seqFile);
+  for (i=0;i<arrayMax (ids);i++) {
+    currItem = arrp (ids,i,Item);
+    if (findInIndex (fP,start,idxStat.st_size,currItem->id,currItem->bin,hits) == 0 && verbose)
+      printf ("Notfound. %s\n",currItem->id);
+  }
+  fclose (fP);
+  arraySort (hits,(ARRAYORDERF)orderHitsByOffset);
+  if (verbose)
+    printf ("#INFO %d of %d ids found in index\n",arrayMax (hits),arrayMax (ids));
+
+  if (bgzf_isBgzf (seqFile))
+    bgzf = bgzf_openRead (seqFile);
+  else
+    inP = hlr_fopenRead (seqFile);
+  for (i=0;i<arrayMax (hits);i++) {
+    currHit = arrp (hits,i,Hit);
+    outFp = currHit->bin >= 0 ? array (binFiles,currHit->bin,FILE*) : stdout;
+    if (bgzf != NULL) {
+      if (!bgzf_seek (bgzf,currHit->offset))
+        die ("cannot seek to offset %llu in %s; rebuild the index with -index",
+             (unsigned long long)currHit->offset,seqFile);
+    }
+    else if (fseeko (inP,(off_t)currHit->offset,SEEK_SET) != 0)
+      die ("cannot seek to offset %llu in %s",(unsigned long long)currHit->offset,seqFile);
+    for (k=0;;k++) {
+      if (bgzf != NULL) {
+        if ((line = bgzf_getLine (bgzf)) == NULL)
+          break;
+      }
+      else {
+        if ((n = getline (&line,&lineSize,inP)) < 0)
+          break;
+        if (n > 0 && line[n-1] == '\n')
+          line[n-1] = '\0';
+      }
+      if ((isFastq && k == 4) || (!isFastq && k > 0 && line[0] == '>'))
+        break;
+      if (k == 0 && !strEqual (recordId (line,isFastq,delim),currHit->id))
+        die ("index %s%s: the record at offset %llu is not %s; rebuild it with -index",
+             seqFile,INDEX_SUFFIX,(unsigned long long)currHit->offset,currHit->id);
+      fputs (line,outFp);
+      fputc ('\n',outFp);
+    }
+    if (k == 0)
+      die ("index %s%s: no record at offset %llu; rebuild it with -index",
+           seqFile,INDEX_SUFFIX,(unsigned long long)currHit->offset);
+  }
+  if (bgzf != NULL)
+    bgzf_close (bgzf);
+  else {
+    fclose (inP);
+    free (line);
+  }
+  arrayDestroy (hits);
+  stringDestroy (str);
+}
+
+
+static FILE *openBinFile (char *prefix,char *bin,char *suffix,size_t bufSize)
+{
+  Stringa str = stringCreate (100);
+  FILE *fP;
+
+  stringPrintf (str,"%s%s.%s",prefix,bin,suffix);
+  fP = hlr_fopenWrite (string (str));
+  setvbuf (fP,NULL,_IOFBF,bufSize);
+  stringDestroy (str);
+  return fP;
 }
 
 
 int main (int argc,char *argv[])
 {
   char *line = NULL;
-  LineStream ls;
-  Texta ids = arrayCreate (1000,Texta);
+  LineReader ls;
+  Array ids = arrayCreate (1000,Item);
+  Item *currItem;
+  Item oneItem;
   Texta it;
+  StrHash bins = strhash_create (16);
+  Array binFiles = arrayCreate (10,FILE*);
+  FILE *unassigned = NULL;
+  FILE *outFp = stdout;
   int not = 0;
   int quick = 0;
+  int useBins = 0;
+  int i;
   Stringa delim = NULL;
   Stringa str = stringCreate (100);
 
-  if (arg_init (argc,argv,"verbose,0 delimiter,1 useEntireIdLine,0 quick,0 not,0 fasta,1 fastq,1","ids",usagef) != argc)
+  if (arg_init (argc,argv,"verbose,0 delimiter,1 useEntireIdLine,0 quick,0 not,0 "
+                "bins,0 bin-prefix,1 unassigned,1 index,0 use-index,0 fasta,1 fastq,1 ids,1","",usagef) != argc)
     die ("wrong number of arguments; invoke program without params for help");
   
   if (arg_present ("verbose"))
@@ -57,13 +416,29 @@ int main (int argc,char *argv[])
     not = 1;
   if (arg_present ("quick"))
     quick = 1;
+  if (arg_present ("bins")) {
+    useBins = 1;
+    if (not == 1)
+      die ("-bins cannot be combined with -not; use -unassigned instead");
+    if (arg_present ("useEntireIdLine"))
+      die ("-bins cannot be combined with -useEntireIdLine");
+    if (quick == 1 && arg_present ("unassigned"))
+      die ("-quick cannot be combined with -unassigned: the sequences after the last match would be missing");
+  }
+  else if (arg_present ("unassigned") || arg_present ("bin-prefix"))
+    die ("-unassigned and -bin-prefix require -bins");
+  if (!arg_present ("fasta") && !arg_present ("fastq"))
+    die ("either -fasta or -fastq is required");
+  if (!arg_present ("ids") && !arg_present ("index"))
+    die ("-ids is required");
+  if (arg_present ("use-index") && (not == 1 || arg_present ("unassigned")))
+    die ("-use-index cannot be combined with -not or -unassigned");
 
   if (arg_present ("delimiter")) {
     delim = stringCreate (10);
     if (strstr (arg_get ("delimiter"),"TAB")) {
       stringClear (delim);
       char *tmp = hlr_strdup (arg_get ("delimiter"));
-      int i;
       for (i=0;i<strlen (tmp);i++) {
         if (tmp[i] != 'T' && tmp[i] != 'A' && tmp[i] != 'B') {
           stringCatChar (delim,tmp[i]);
@@ -78,31 +453,66 @@ int main (int argc,char *argv[])
       printf ("#INFO field delimiter \"%s\"\n",string (delim));
   }
 
-  /* input read identifiers from ids file */
-  ls = ls_createFromFile (arg_get ("ids"));
-  while (line = ls_nextLine (ls)) {
+  if (arg_present ("index")) {
+    if (arg_present ("fastq"))
+      buildIndex (arg_get ("fastq"),1,delim);
+    else
+      buildIndex (arg_get ("fasta"),0,delim);
+    return 0;
+  }
+
+  /* input read identifiers and optional bin names from ids file */
+  ls = lr_createFromFile (arg_get ("ids"));
+  while (line = lr_nextLine (ls)) {
     if (strstr (line,"Ensembl"))
       continue;
     if (delim != NULL)
       it = textFieldtokP (line,string (delim));
     else
       it = textFieldtokP (line," \t");
+    currItem = arrayp (ids,arrayMax (ids),Item);
     if (arg_present ("useEntireIdLine")) 
-      textAdd (ids,line);
+      currItem->id = hlr_strdup (line);
     else if (textItem (it,0)[0]=='>')
-      textAdd (ids,textItem (it,0)+1);
+      currItem->id = hlr_strdup (textItem (it,0)+1);
     else
-      textAdd (ids,textItem (it,0));
+      currItem->id = hlr_strdup (textItem (it,0));
+    currItem->bin = -1;
+    if (useBins) {
+      if (arrayMax (it) < 2 || textItem (it,1)[0] == '\0')
+        die ("missing bin name in column 2 of ids file on line %s",line);
+      currItem->bin = strhash_add (bins,textItem (it,1),strlen (textItem (it,1)));
+    }
     textDestroy (it);
   }
-  ls_destroy (ls);
-  arraySort (ids,(ARRAYORDERF)arrayStrcmp);
+  lr_destroy (ls);
+  arraySort (ids,(ARRAYORDERF)orderItemsById);
+
+  /* one buffered writer per bin, opened once for the single pass */
+  if (useBins) {
+    char *prefix = arg_present ("bin-prefix") ? arg_get ("bin-prefix") : "";
+    char *suffix = arg_present ("fastq") ? "fastq" : "fasta";
+    // bins and unassigned share a fixed buffer budget, so many bins don't need GBs
+    size_t bufSize = BIN_BUFFER_TOTAL / (strhash_count (bins) + 1);
+    if (bufSize > BIN_BUFFER_SIZE)
+      bufSize = BIN_BUFFER_SIZE;
+    if (bufSize < BIN_BUFFER_MIN)
+      bufSize = BIN_BUFFER_MIN;
+    for (i=0;i<strhash_count (bins);i++)
+      array (binFiles,i,FILE*) = openBinFile (prefix,strhash_key (bins,i),suffix,bufSize);
+    if (arg_present ("unassigned")) {
+      unassigned = hlr_fopenWrite (arg_get ("unassigned"));
+      setvbuf (unassigned,NULL,_IOFBF,bufSize);
+    }
+    if (verbose)
+      printf ("#INFO %d bins\n",strhash_count (bins));
+  }
 
 
   char *id = NULL;
   int index;
   int found = 0;
-  int doPrint;
+  int doPrint = 0;
   int k = 0;
   char *key = NULL;
   /*
@@ -111,22 +521,30 @@ int main (int argc,char *argv[])
     +
     CCCFFFDFHHHHHJJJJJJJJJJJJHJJIJJJGHJIIFHHIJIBHHIJJJJ
   */
-  if (arg_present ("fastq")) {
+  if (arg_present ("use-index")) {
+    if (arg_present ("fastq"))
+      extractByIndex (arg_get ("fastq"),1,delim,ids,binFiles);
+    else
+      extractByIndex (arg_get ("fasta"),0,delim,ids,binFiles);
+  }
+  else if (arg_present ("fastq")) {
     if (strstr (arg_get ("fastq"),".gz")) {
       stringPrintf (str,"gunzip -c %s",arg_get ("fastq"));
-      ls = ls_createFromPipe (string (str));
+      ls = lr_createFromPipe (string (str));
     }
     else
-      ls = ls_createFromFile (arg_get ("fastq"));
-    while (line = ls_nextLine (ls)) {
+      ls = lr_createFromFile (arg_get ("fastq"));
+    while (line = lr_nextLine (ls)) {
       /* fetch read name key from first line */
       if (key == NULL) {
         it = textFieldtokP (line,":");
         strReplace (&key,textItem (it,0));
         textDestroy (it);
       }
-      if (doPrint == 1 && !strStartsWith (line,key))
-        puts (line);
+      if (doPrint == 1 && !strStartsWith (line,key)) {
+        fputs (line,outFp);
+        fputc ('\n',outFp);
+      }
       if (!strStartsWith (line,key))
         continue;
 
@@ -141,10 +559,11 @@ int main (int argc,char *argv[])
         id = textItem (it,0)+1;
       else
         id = textItem (it,0);
-      k = arrayFind (ids,&id,&index,(ARRAYORDERF)arrayStrcmp);
+      oneItem.id = id;
+      k = arrayFind (ids,&oneItem,&index,(ARRAYORDERF)orderItemsById);
       if (verbose) {
         if (k==1)
-          printf ("Found %s\tk=%d\t%s\n",id,index,textItem (ids,index));
+          printf ("Found %s\tk=%d\t%s\n",id,index,arrp (ids,index,Item)->id);
         else 
           printf ("Notfound. %s\n",line);
       }
@@ -152,21 +571,31 @@ int main (int argc,char *argv[])
       if ((k && not == 0)||(!k && not == 1)) {
         found++;
         doPrint = 1;
-        puts (line);
+        outFp = useBins ? array (binFiles,arrp (ids,index,Item)->bin,FILE*) : stdout;
+      }
+      else if (unassigned != NULL) {
+        doPrint = 1;
+        outFp = unassigned;
+      }
+      if (doPrint == 1) {
+        fputs (line,outFp);
+        fputc ('\n',outFp);
       }
     }
-    ls_destroy (ls);
+    lr_destroy (ls);
   }
   else {
     if (strstr (arg_get ("fasta"),".gz")) {
       stringPrintf (str,"gunzip -c %s",arg_get ("fasta"));
-      ls = ls_createFromPipe (string (str));
+      ls = lr_createFromPipe (string (str));
     }
     else
-      ls = ls_createFromFile (arg_get ("fasta"));
-    while (line = ls_nextLine (ls)) {
-      if (doPrint == 1 && line[0] != '>')
-        puts (line);
+      ls = lr_createFromFile (arg_get ("fasta"));
+    while (line = lr_nextLine (ls)) {
+      if (doPrint == 1 && line[0] != '>') {
+        fputs (line,outFp);
+        fputc ('\n',outFp);
+      }
       if (line[0] != '>')
         continue;
       
@@ -186,11 +615,12 @@ int main (int argc,char *argv[])
       else
         strReplace (&id,textItem (it,0)+1);
       
-      k = arrayFind (ids,&id,&index,(ARRAYORDERF)arrayStrcmp);
+      oneItem.id = id;
+      k = arrayFind (ids,&oneItem,&index,(ARRAYORDERF)orderItemsById);
       
       if (verbose) {
         if (k==1)
-          printf ("Found %s\tk=%d\t%s\n",id,index,textItem (ids,index));
+          printf ("Found %s\tk=%d\t%s\n",id,index,arrp (ids,index,Item)->id);
         else {
           printf ("Notfound. %d fields,field 1=\"%s\"\n",arrayMax (it),id);
       }
@@ -199,16 +629,31 @@ int main (int argc,char *argv[])
       if ((k && not == 0)||(!k && not == 1)) {
         found++;
         doPrint = 1;
-        puts (line);
+        outFp = useBins ? array (binFiles,arrp (ids,index,Item)->bin,FILE*) : stdout;
+      }
+      else if (unassigned != NULL) {
+        doPrint = 1;
+        outFp = unassigned;
+      }
+      if (doPrint == 1) {
+        fputs (line,outFp);
+        fputc ('\n',outFp);
       }
     textDestroy (it);
     }
-    ls_destroy (ls);
+    lr_destroy (ls);
 
     //    if (not == 0 && found != arrayMax (ids))
     //      printf ("# not found ids %d\n",arrayMax (ids)-found);
   }
 
-  textDestroy (ids);
+  for (i=0;i<arrayMax (binFiles);i++)
+    fclose (array (binFiles,i,FILE*));
+  if (unassigned != NULL)
+    fclose (unassigned);
+  strhash_destroy (bins);
+  for (i=0;i<arrayMax (ids);i++)
+    hlr_free (arrp (ids,i,Item)->id);
+  arrayDestroy (ids);
   return 0;
 }
@@ -0,0 +1,307 @@
+#include <math.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "format.h"
+#include "log.h"
+#include "linereader.h"
+#include "gct.h"
+#include "gctb.h"
+
+#define MOVE_BLOCK_SIZE 1048576
+
+
+/*
+  Reads the 3 header lines of a GCT file from ls; returns the sample
+  names (columns 3 onwards of line 3) and, if numRows is not NULL, the
+  number of rows given on line 2
+*/
+Texta gct_readHeader (LineReader ls,int *numRows)
+{
+  char *line;
+  Texta it;
+  Texta sampleNames = textCreate (100);
+  int i;
+
+  while (line = lr_nextLine (ls)) {
+    if (lr_lineCountGet (ls) == 2 && numRows != NULL)
+      *numRows = atoi (line);
+    if (lr_lineCountGet (ls) < 3)
+      continue;
+    it = textStrtokP (line,"\t");
+    for (i=2;i<arrayMax (it);i++)
+      textAdd (sampleNames,textItem (it,i));
+    textDestroy (it);
+    return sampleNames;
+  }
+  die ("GCT header: less than 3 lines");
+  return NULL;
+}
+
+
+
+/*
+  Returns the sample names (columns 3 onwards of line 3) of GCT file
+  fileName; only the 3 header lines are read. For a binary GCT (.gctb)
+  the column names are returned
+*/
+Texta gct_sampleNames (char *fileName)
+{
+  LineReader ls;
+  Texta sampleNames;
+  Gctb g;
+  int j;
+
+  if (gctb_isGctb (fileName)) {
+    g = gctb_open (fileName);
+    sampleNames = textCreate (gctb_numCols (g));
+    for (j=0;j<gctb_numCols (g);j++)
+      textAdd (sampleNames,gctb_colName (g,j));
+    gctb_close (g);
+    return sampleNames;
+  }
+  ls = lr_createFromFile (fileName);
+  sampleNames = gct_readHeader (ls,NULL);
+  lr_destroy (ls);
+  return sampleNames;
+}
+
+
+
+/* Returns line 3 of a GCT header with the given sample names, allocated */
+char *gct_headerLine (Texta sampleNames)
+{
+  Stringa s = stringCreate (1000);
+  char *line;
+  int j;
+
+  stringCpy (s,"Name\tDescription");
+  for (j=0;j<arrayMax (sampleNames);j++)
+    stringAppendf (s,"\t%s",textItem (sampleNames,j));
+  line = hlr_strdup (string (s));
+  stringDestroy (s);
+  return line;
+}
+
+
+
+/*
+  Creates fileName as binary GCT (.gctb) of the given value type for
+  rows with the given sample names, added with gctb_addRow; the number
+  of rows is set by gctb_finish
+*/
+GctbWriter gct_gctbWriter (char *fileName,Texta sampleNames,int type)
+{
+  GctbWriter w;
+  int j;
+
+  w = gctb_createWriter (fileName,-1,arrayMax (sampleNames),type,GCTB_ROW_MAJOR);
+  for (j=0;j<arrayMax (sampleNames);j++)
+    gctb_setColName (w,j,textItem (sampleNames,j));
+  return w;
+}
+
+
+
+/*
+  Splits a GCT data row in place into the name (line), the description
+  and the values after the second tab ("" if the row has no values)
+*/
+void gct_splitRow (char *line,char **desc,char **values)
+{
+  char *s;
+
+  if ((s = strchr (line,'\t')) == NULL)
+    die ("GCT row without description: %s",line);
+  *s = '\0';
+  *desc = s + 1;
+  if ((s = strchr (*desc,'\t')) != NULL) {
+    *s = '\0';
+    *values = s + 1;
+  }
+  else
+    *values = *desc + strlen (*desc);
+}
+
+
+
+/*
+  Parses the numCols values of a row split by gct_splitRow into values;
+  values that are not numbers (e.g. NA) and empty ones are NaN. Dies if
+  the row does not have numCols values; fileName and id are for the
+  messages
+*/
+void gct_parseValues (char *s,double *values,int numCols,char *fileName,char *id)
+{
+  char *end;
+  int j;
+
+  for (j=0;j<numCols;j++) {
+    values[j] = gct_strtod (s,&end);
+    if (end == s && isnan (values[j]))
+      end = s + strcspn (s,"\t");
+    if (*end == '\0' && j + 1 < numCols)
+      die ("%s: row %s has %d values, expected %d",fileName,id,j + 1,numCols);
+    if (*end != '\t' && *end != '\0')
+      die ("%s: row %s: invalid value %.*s",fileName,id,(int)strcspn (s,"\t"),s);
+    s = *end == '\t' ? end + 1 : end;
+  }
+  if (*s != '\0')
+    die ("%s: row %s has more than %d values",fileName,id,numCols);
+}
+
+
+
+/*
+  Parses a number as strtod does, with a fast path for plain decimals
+  (sign, up to 15 significant digits, optional fraction); returns NAN
+  and sets *end to s if s does not start with a number
+*/
+double gct_strtod (char *s,char **end)
+{
+  static double pow10[] = {1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,
+                           1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,
+                           1e20,1e21,1e22};
+  char *p = s;
+  int negative = 0;
+  unsigned long long mantissa = 0;
+  int digits = 0;
+  int scale = 0;
+  double value;
+
+  if (*p == '-' || *p == '+')
+    negative = *p++ == '-';
+  while (*p >= '0' && *p <= '9') {
+    mantissa = mantissa * 10 + (*p++ - '0');
+    digits++;
+  }
+  if (*p == '.') {
+    p++;
+    while (*p >= '0' && *p <= '9') {
+      mantissa = mantissa * 10 + (*p++ - '0');
+      digits++;
+      scale++;
+    }
+  }
+  if (digits == 0 || digits > 15 || *p == 'e' || *p == 'E') {
+    /* exponents, long mantissas, inf, nan: the exact but slower way;
+       strtod would skip white space, i.e. an empty field */
+    if (isspace ((unsigned char)*s)) {
+      *end = s;
+      return NAN;
+    }
+    value = strtod (s,end);
+    if (*end == s)
+      return NAN;
+    return value;
+  }
+  *end = p;
+  /* both operands are exact, so the quotient is correctly rounded */
+  value = (double)mantissa / pow10[scale];
+  return negative ? -value : value;
+}
+
+
+
+/*
+  Starts writing a GCT to fp whose number of rows is known only after the
+  rows are written (maxRows is the expected number). line3 is the column
+  header line without newline. The rows are written to gct_outRows (g);
+  gct_outFinish sets the row count: in place if fp is a regular file that
+  can be rewritten (the rows are moved if the count has a different
+  number of digits than maxRows), otherwise the rows go to a temporary
+  file and are copied after the header.
+*/
+GctOut gct_outCreate (FILE *fp,int maxRows,int numCols,char *line3)
+{
+  GctOut g;
+  struct stat st;
+  char procName[64];
+  int flags;
+
+  g = hlr_calloc (1,sizeof (GctOutStruct));
+  g->fp = fp;
+  g->numCols = numCols;
+  g->line3 = hlr_strdup (line3);
+  g->maxRows = maxRows < 0 ? 0 : maxRows;
+  fflush (fp);
+  flags = fcntl (fileno (fp),F_GETFL);
+  /* the rows may have to be moved, so they are read back through readFd */
+  g->readFd = -1;
+  if (fstat (fileno (fp),&st) == 0 && S_ISREG (st.st_mode) &&
+      flags != -1 && !(flags & O_APPEND) && ftello (fp) != -1) {
+    sprintf (procName,"/proc/self/fd/%d",fileno (fp));
+    g->readFd = open (procName,O_RDONLY);
+  }
+  if (g->readFd != -1) {
+    fprintf (fp,"#1.2\n");
+    g->countOffset = ftello (fp);
+    g->width = fprintf (fp,"%d",g->maxRows);
+    fprintf (fp,"\t%d\n%s\n",numCols,line3);
+    g->rows = fp;
+  }
+  else if ((g->rows = tmpfile ()) == NULL)
+    die ("gct_outCreate: cannot create temporary file");
+  return g;
+}
+
+
+
+/*
+  Moves the size bytes at from in file fd (read through readFd) to to, front to back if
+  moved towards the start of the file, else back to front
+*/
+static void moveData (int readFd,int fd,off_t from,off_t to,off_t size)
+{
+  char *buffer = hlr_malloc (MOVE_BLOCK_SIZE);
+  off_t done,pos;
+  size_t n;
+
+  for (done=0;done<size;done+=n) {
+    n = size - done < MOVE_BLOCK_SIZE ? size - done : MOVE_BLOCK_SIZE;
+    pos = to < from ? done : size - done - n;
+    if (pread (readFd,buffer,n,from + pos) != n || pwrite (fd,buffer,n,to + pos) != n)
+      die ("gct_outFinish: cannot move the rows");
+  }
+  hlr_free (buffer);
+}
+
+
+
+void gct_outFinish (GctOut g,int numRows)
+{
+  char buffer[65536];
+  size_t n;
+  off_t end,rowsStart;
+  int width;
+
+  if (g->rows == g->fp) {
+    width = snprintf (buffer,sizeof (buffer),"%d",numRows);
+    if (fflush (g->fp) != 0 || (end = ftello (g->fp)) == -1)
+      die ("gct_outFinish: write failed");
+    if (width != g->width) {
+      /* the count has more or fewer digits than announced: make room for it */
+      rowsStart = g->countOffset + g->width;
+      moveData (g->readFd,fileno (g->fp),rowsStart,rowsStart + width - g->width,end - rowsStart);
+      if (width < g->width && ftruncate (fileno (g->fp),end + width - g->width) != 0)
+        die ("gct_outFinish: write failed");
+    }
+    if (pwrite (fileno (g->fp),buffer,width,g->countOffset) != width)
+      die ("gct_outFinish: write failed");
+    fseeko (g->fp,0,SEEK_END);
+    close (g->readFd);
+  }
+  else {
+    fprintf (g->fp,"#1.2\n%d\t%d\n%s\n",numRows,g->numCols,g->line3);
+    rewind (g->rows);
+    while ((n = fread (buffer,1,sizeof (buffer),g->rows)) > 0)
+      if (fwrite (buffer,1,n,g->fp) != n)
+        die ("gct_outFinish: write failed");
+    fclose (g->rows);
+  }
+  if (fflush (g->fp) != 0)
+    die ("gct_outFinish: write failed");
+  hlr_free (g->line3);
+  hlr_free (g);
+}
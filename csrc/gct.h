@@ -0,0 +1,42 @@
+#ifndef GCT_H
+#define GCT_H
+
+/*
+  Helpers for GCT files:
+    line 1: #1.2
+    line 2: number of rows and number of samples
+    line 3: Name, Description and the sample names
+    then one row per line: name, description and one value per sample
+*/
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "format.h"
+#include "linereader.h"
+#include "gctb.h"
+
+/* output GCT with the row count set after the rows, see gct_outCreate */
+typedef struct {
+  FILE *fp;
+  FILE *rows;
+  off_t countOffset;
+  int readFd;                 /* fp opened for reading, -1 if the rows are spooled */
+  int maxRows;
+  int width;                  /* digits of the count at countOffset */
+  int numCols;
+  char *line3;
+} GctOutStruct,*GctOut;
+
+#define gct_outRows(g) ((g)->rows)
+
+extern Texta gct_readHeader (LineReader ls,int *numRows);
+extern Texta gct_sampleNames (char *fileName);
+extern char *gct_headerLine (Texta sampleNames);
+extern GctbWriter gct_gctbWriter (char *fileName,Texta sampleNames,int type);
+extern void gct_splitRow (char *line,char **desc,char **values);
+extern void gct_parseValues (char *s,double *values,int numCols,char *fileName,char *id);
+extern double gct_strtod (char *s,char **end);
+extern GctOut gct_outCreate (FILE *fp,int maxRows,int numCols,char *line3);
+extern void gct_outFinish (GctOut g,int numRows);
+
+#endif
@@ -0,0 +1,80 @@
+#include "format.h"
+#include "log.h"
+#include "linereader.h"
+#include "arg.h"
+#include "gct.h"
+#include "gctb.h"
+
+#define AUTHOR_MAIL "roland.schmucki@roche.com"
+
+
+void usagef (int level)
+{
+  romsg ("Description: \n"
+         "\n"
+         "Converts a text GCT file into a binary GCT file (.gctb) that the tools \n"
+         "read by memory mapping, without parsing text. Values that are not \n"
+         "numbers (e.g. NA or empty) are stored as missing. \n"
+         "\n"
+         "Usage: %s [-type TYPE] [-layout LAYOUT] -i GCT_FILE -o GCTB_FILE \n"
+         "\n"
+         "Mandatory parameters: \n"
+         "\n"
+         "\t-i GCT_FILE      input GCT file (- for stdin) \n"
+         "\t-o GCTB_FILE     output binary GCT file \n"
+         "\n"
+         "Optional parameters: \n"
+         "\n"
+         "\t-type TYPE       value type: float32 (default), float64 or int32 \n"
+         "\t                 (int32 rounds to the nearest integer) \n"
+         "\t-layout LAYOUT   row (default, fast access to rows) or col \n"
+         "\t                 (fast access to samples) \n"
+         "\n"
+         "Report bugs and feedback to %s \n",
+         arg_getProgName (),AUTHOR_MAIL);
+}
+
+
+
+int main (int argc,char *argv[])
+{
+  LineReader ls;
+  char *line,*desc,*s;
+  Texta sampleNames;
+  GctbWriter w;
+  double *values;
+  int type = GCTB_FLOAT32;
+  int layout = GCTB_ROW_MAJOR;
+  int numRows,numCols;
+  int j;
+
+  if (arg_init (argc,argv,"type,1 layout,1","i o",usagef) != argc)
+    die ("wrong number of arguments; invoke program without params for help");
+  if (arg_present ("type"))
+    type = gctb_typeFromName (arg_get ("type"));
+  if (arg_present ("layout")) {
+    if (strEqual (arg_get ("layout"),"row"))
+      layout = GCTB_ROW_MAJOR;
+    else if (strEqual (arg_get ("layout"),"col"))
+      layout = GCTB_COL_MAJOR;
+    else
+      die ("unknown layout %s, expected row or col",arg_get ("layout"));
+  }
+
+  ls = lr_createFromFile (arg_get ("i"));
+  sampleNames = gct_readHeader (ls,&numRows);
+  numCols = arrayMax (sampleNames);
+  w = gctb_createWriter (arg_get ("o"),numRows,numCols,type,layout);
+  for (j=0;j<numCols;j++)
+    gctb_setColName (w,j,textItem (sampleNames,j));
+  values = hlr_malloc ((numCols + 1) * sizeof (double));
+  while (line = lr_nextLine (ls)) {
+    gct_splitRow (line,&desc,&s);
+    gct_parseValues (s,values,numCols,arg_get ("i"),line);
+    gctb_addRow (w,line,desc,values);
+  }
+  lr_destroy (ls);
+  gctb_finish (w);
+  hlr_free (values);
+  return 0;
+}
@@ -0,0 +1,41 @@
+#include "format.h"
+#include "log.h"
+#include "arg.h"
+#include "hlrmisc.h"
+#include "gctindex.h"
+
+#define AUTHOR_MAIL "roland.schmucki@roche.com"
+
+
+void usagef (int level)
+{
+  romsg ("Description: \n"
+         "\n"
+         "Writes a row index next to each GCT file (GCT_FILE.gcti): the byte offset \n"
+         "of every row, sorted by row id, and the sample names. subset_gct -k then \n"
+         "reads only the requested rows instead of scanning the file. \n"
+         "The index records the size, modification time and inode of the GCT file \n"
+         "and is ignored once the GCT file changes; run gct_index again after changes. \n"
+         "\n"
+         "Usage: %s GCT_FILE [GCT_FILE ...] \n"
+         "\n"
+         "Report bugs and feedback to %s \n",
+         arg_getProgName (),AUTHOR_MAIL);
+}
+
+
+
+int main (int argc,char *argv[])
+{
+  char *indexFileName;
+  int i;
+
+  if ((i = arg_init (argc,argv,"","",usagef)) == argc)
+    die ("missing GCT file; invoke program without params for help");
+  for (;i<argc;i++) {
+    indexFileName = gcti_fileName (argv[i]);
+    gcti_write (argv[i],indexFileName);
+    hlr_free (indexFileName);
+  }
+  return 0;
+}
@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "log.h"
+#include "hlrmisc.h"
+#include "array.h"
+#include "gctb.h"
+
+
+static size_t typeSize (int type)
+{
+  switch (type) {
+  case GCTB_FLOAT32:
+    return sizeof (float);
+  case GCTB_FLOAT64:
+    return sizeof (double);
+  case GCTB_INT32:
+    return sizeof (int32_t);
+  }
+  die ("gctb: unknown value type %d",type);
+  return 0;
+}
+
+
+
+static uint64_t matrixOffset (void)
+{
+  return (sizeof (GctbHeader) + GCTB_ALIGN - 1) / GCTB_ALIGN * GCTB_ALIGN;
+}
+
+
+
+/* ---------- reader ---------- */
+
+
+/* Returns 1 if fileName starts with the gctb magic */
+int gctb_isGctb (char *fileName)
+{
+  FILE *fp;
+  char magic[8];
+  int ok;
+
+  if ((fp = fopen (fileName,"r")) == NULL)
+    return 0;
+  ok = fread (magic,1,8,fp) == 8 && memcmp (magic,GCTB_MAGIC,8) == 0;
+  fclose (fp);
+  return ok;
+}
+
+
+static void *section (Gctb g,uint64_t offset,uint64_t n,size_t size,char *fileName)
+{
+  if (offset > g->size || n * size > g->size - offset)
+    die ("%s: section out of bounds",fileName);
+  return g->map + offset;
+}
+
+
+/* Map a file written by gctb_finish; dies on a missing or invalid file */
+Gctb gctb_open (char *fileName)
+{
+  Gctb g;
+  GctbHeader *h;
+  struct stat st;
+  int fd;
+
+  if ((fd = open (fileName,O_RDONLY)) < 0)
+    die ("cannot open %s",fileName);
+  if (fstat (fd,&st) != 0 || st.st_size < sizeof (GctbHeader))
+    die ("%s is not a gctb file",fileName);
+  g = hlr_calloc (1,sizeof (GctbStruct));
+  g->size = st.st_size;
+  g->map = mmap (NULL,g->size,PROT_READ,MAP_SHARED,fd,0);
+  close (fd);
+  if (g->map == MAP_FAILED)
+    die ("cannot map %s",fileName);
+  h = g->header = (GctbHeader *)g->map;
+  if (memcmp (h->magic,GCTB_MAGIC,8) != 0)
+    die ("%s is not a gctb file",fileName);
+  if (h->version != GCTB_VERSION)
+    die ("%s: gctb version %u, expected %d; convert it again with gct2gctb",
+         fileName,h->version,GCTB_VERSION);
+  g->matrix = section (g,h->matrixOffset,h->numRows * h->numCols,typeSize (h->type),fileName);
+  g->rowIds = section (g,h->rowIdsOffset,h->numRows,sizeof (uint64_t),fileName);
+  g->rowDescs = section (g,h->rowDescsOffset,h->numRows,sizeof (uint64_t),fileName);
+  g->colNames = section (g,h->colNamesOffset,h->numCols,sizeof (uint64_t),fileName);
+  g->strings = section (g,h->stringsOffset,h->stringsSize,1,fileName);
+  if (h->stringsSize == 0 || g->strings[h->stringsSize-1] != '\0')
+    die ("%s: invalid string section",fileName);
+  return g;
+}
+
+
+void gctb_close (Gctb g)
+{
+  if (g == NULL)
+    return;
+  munmap (g->map,g->size);
+  free (g);
+}
+
+
+/* Returns the value in row i and column j; missing values are NaN */
+double gctb_value (Gctb g,long i,long j)
+{
+  long k = g->header->layout == GCTB_ROW_MAJOR ?
+    i * gctb_numCols (g) + j : j * gctb_numRows (g) + i;
+  int32_t v;
+
+  switch (g->header->type) {
+  case GCTB_FLOAT32:
+    return ((float *)g->matrix)[k];
+  case GCTB_FLOAT64:
+    return ((double *)g->matrix)[k];
+  }
+  v = ((int32_t *)g->matrix)[k];
+  return v == GCTB_INT32_NA ? NAN : v;
+}
+
+
+/* Copies row i into values (numCols doubles) */
+void gctb_row (Gctb g,long i,double *values)
+{
+  long j,n = gctb_numCols (g);
+  float *f;
+  double *d;
+
+  if (g->header->layout == GCTB_ROW_MAJOR && g->header->type == GCTB_FLOAT32) {
+    f = (float *)g->matrix + i * n;
+    for (j=0;j<n;j++)
+      values[j] = f[j];
+  }
+  else if (g->header->layout == GCTB_ROW_MAJOR && g->header->type == GCTB_FLOAT64) {
+    d = (double *)g->matrix + i * n;
+    memcpy (values,d,n * sizeof (double));
+  }
+  else
+    for (j=0;j<n;j++)
+      values[j] = gctb_value (g,i,j);
+}
+
+
+/* Writes v to fp with the fewest significant digits that read back to v of type */
+void gctb_writeValue (FILE *fp,double v,int type)
+{
+  char buffer[40];
+  int precision;
+
+  if (isnan (v)) {
+    fputs ("NA",fp);
+    return;
+  }
+  if (type == GCTB_INT32) {
+    fprintf (fp,"%d",(int)v);
+    return;
+  }
+  for (precision=type == GCTB_FLOAT32 ? 6 : 15;;precision++) {
+    sprintf (buffer,"%.*g",precision,v);
+    if (type == GCTB_FLOAT32 ? strtof (buffer,NULL) == (float)v : strtod (buffer,NULL) == v)
+      break;
+  }
+  fputs (buffer,fp);
+}
+
+
+/* Writes a text GCT row: id, desc and numCols values with gctb_writeValue */
+void gctb_printRow (FILE *fp,char *id,char *desc,double *values,long numCols,int type)
+{
+  long j;
+
+  fprintf (fp,"%s\t%s",id,desc);
+  for (j=0;j<numCols;j++) {
+    putc ('\t',fp);
+    gctb_writeValue (fp,values[j],type);
+  }
+  putc ('\n',fp);
+}
+
+
+/* ---------- writer ---------- */
+
+
+/* Returns GCTB_FLOAT32, GCTB_FLOAT64 or GCTB_INT32 for float32, float64 or int32 */
+int gctb_typeFromName (char *name)
+{
+  if (strcmp (name,"float32") == 0)
+    return GCTB_FLOAT32;
+  if (strcmp (name,"float64") == 0)
+    return GCTB_FLOAT64;
+  if (strcmp (name,"int32") == 0)
+    return GCTB_INT32;
+  die ("unknown value type %s, expected float32, float64 or int32",name);
+  return 0;
+}
+
+
+static uint64_t addString (GctbWriter w,char *s)
+{
+  uint64_t offset = arrayMax (w->strings);
+  int len = strlen (s);
+
+  arrayp (w->strings,offset + len,char);
+  memcpy (arrp (w->strings,offset,char),s,len);
+  arru (w->strings,offset + len,char) = '\0';
+  return offset;
+}
+
+
+/* maps the matrix with room for capacity rows (row-major) or columns (column-major) */
+static void mapMatrix (GctbWriter w,long capacity)
+{
+  long other = w->layout == GCTB_ROW_MAJOR ? w->numCols : w->numRows;
+
+  if (w->map != NULL && munmap (w->map,w->mapSize) != 0)
+    die ("error writing %s",w->fileName);
+  w->capacity = capacity;
+  w->mapSize = matrixOffset () + (size_t)capacity * other * typeSize (w->type);
+  if (ftruncate (w->fd,w->mapSize) != 0)
+    die ("cannot allocate %s",w->fileName);
+  w->map = mmap (NULL,w->mapSize,PROT_READ | PROT_WRITE,MAP_SHARED,w->fd,0);
+  if (w->map == MAP_FAILED)
+    die ("cannot map %s",w->fileName);
+}
+
+
+/*
+  Creates fileName for a numRows x numCols matrix; the matrix is mapped,
+  so rows can be added in any layout without buffering. numRows of a
+  row-major or numCols of a column-major matrix may be -1 if not known
+  in advance: the file then grows as rows or columns are added
+*/
+GctbWriter gctb_createWriter (char *fileName,long numRows,long numCols,int type,int layout)
+{
+  GctbWriter w;
+  long i,j;
+
+  if ((layout == GCTB_ROW_MAJOR ? numCols : numRows) < 0)
+    die ("gctb_createWriter: only the number of %s may be unknown",
+         layout == GCTB_ROW_MAJOR ? "rows of a row-major" : "columns of a column-major");
+  w = hlr_calloc (1,sizeof (GctbWriterStruct));
+  w->fileName = hlr_strdup (fileName);
+  w->type = type;
+  w->layout = layout;
+  w->numRows = numRows;
+  w->numCols = numCols;
+  w->grow = numRows < 0 || numCols < 0;
+  if ((w->fd = open (fileName,O_RDWR | O_CREAT | O_TRUNC,0666)) < 0)
+    die ("cannot create %s",fileName);
+  mapMatrix (w,w->grow ? 1024 : (layout == GCTB_ROW_MAJOR ? numRows : numCols));
+  w->rowIds = arrayCreate (numRows > 0 ? numRows : 1000,uint64_t);
+  w->rowDescs = arrayCreate (numRows > 0 ? numRows : 1000,uint64_t);
+  w->colNames = arrayCreate (numCols > 0 ? numCols : 1000,uint64_t);
+  w->strings = arrayCreate (1000000,char);
+  addString (w,"");
+  for (i=0;i<numRows;i++) {
+    array (w->rowIds,i,uint64_t) = 0;
+    array (w->rowDescs,i,uint64_t) = 0;
+  }
+  for (j=0;j<numCols;j++)
+    array (w->colNames,j,uint64_t) = 0;
+  return w;
+}
+
+
+void gctb_setColName (GctbWriter w,long j,char *name)
+{
+  array (w->colNames,j,uint64_t) = addString (w,name);
+}
+
+
+/* sets id and description of row i, for files filled by gctb_addCol */
+void gctb_setRowName (GctbWriter w,long i,char *id,char *desc)
+{
+  array (w->rowIds,i,uint64_t) = addString (w,id);
+  array (w->rowDescs,i,uint64_t) = addString (w,desc);
+}
+
+
+/* stores n values in the matrix from element k on, step elements apart */
+static void storeValues (GctbWriter w,long k,long step,long n,double *values,
+                         char *kind,char *name)
+{
+  char *matrix = w->map + matrixOffset ();
+  long j;
+
+  for (j=0;j<n;j++,k+=step) {
+    if (w->type == GCTB_FLOAT32)
+      ((float *)matrix)[k] = values[j];
+    else if (w->type == GCTB_FLOAT64)
+      ((double *)matrix)[k] = values[j];
+    else if (isnan (values[j]))
+      ((int32_t *)matrix)[k] = GCTB_INT32_NA;
+    else if (values[j] > INT32_MAX || values[j] <= INT32_MIN)
+      die ("%s: value %g of %s %s out of the int32 range",w->fileName,values[j],kind,name);
+    else
+      ((int32_t *)matrix)[k] = lrint (values[j]);
+  }
+}
+
+
+/* Adds the next row; values holds numCols values, NaN if missing */
+void gctb_addRow (GctbWriter w,char *id,char *desc,double *values)
+{
+  long i = w->rowsAdded;
+
+  if (w->numCols < 0)
+    die ("%s: rows added to a file of unknown width",w->fileName);
+  if (i == w->numRows)
+    die ("%s: more than %ld rows",w->fileName,w->numRows);
+  if (w->grow && i == w->capacity)
+    mapMatrix (w,2 * w->capacity);
+  gctb_setRowName (w,i,id,desc);
+  if (w->layout == GCTB_ROW_MAJOR)
+    storeValues (w,i * w->numCols,1,w->numCols,values,"row",id);
+  else
+    storeValues (w,i,w->numRows,w->numCols,values,"row",id);
+  w->rowsAdded++;
+}
+
+
+/*
+  Adds the next column; values holds numRows values, NaN if missing.
+  Rows are named with gctb_setRowName
+*/
+void gctb_addCol (GctbWriter w,char *name,double *values)
+{
+  long j = w->colsAdded;
+
+  if (w->numRows < 0)
+    die ("%s: columns added to a file of unknown height",w->fileName);
+  if (j == w->numCols)
+    die ("%s: more than %ld columns",w->fileName,w->numCols);
+  if (w->grow && j == w->capacity)
+    mapMatrix (w,2 * w->capacity);
+  gctb_setColName (w,j,name);
+  if (w->layout == GCTB_COL_MAJOR)
+    storeValues (w,j * w->numRows,1,w->numRows,values,"column",name);
+  else
+    storeValues (w,j,w->numCols,w->numRows,values,"column",name);
+  w->colsAdded++;
+}
+
+
+static void writeSection (GctbWriter w,void *data,size_t size,uint64_t *offset)
+{
+  static char zeros[8];
+  off_t pos = lseek (w->fd,0,SEEK_END);
+  int pad = (8 - pos % 8) % 8;
+
+  if (write (w->fd,zeros,pad) != pad ||
+      (size > 0 && write (w->fd,data,size) != size))
+    die ("error writing %s",w->fileName);
+  *offset = pos + pad;
+}
+
+
+/*
+  Writes the tables and the header and closes the file; dies unless all
+  rows (or, if filled by gctb_addCol, all columns) were added
+*/
+void gctb_finish (GctbWriter w)
+{
+  GctbHeader *h = (GctbHeader *)w->map;
+  int byCols = w->colsAdded > 0 || (w->grow && w->layout == GCTB_COL_MAJOR);
+
+  if (w->numRows < 0)
+    w->numRows = w->rowsAdded;
+  if (w->numCols < 0)
+    w->numCols = w->colsAdded;
+  if (byCols && w->colsAdded != w->numCols)
+    die ("%s: %ld columns added, %ld expected",w->fileName,w->colsAdded,w->numCols);
+  if (!byCols && w->rowsAdded != w->numRows)
+    die ("%s: %ld rows added, %ld expected",w->fileName,w->rowsAdded,w->numRows);
+  if (w->grow &&
+      ftruncate (w->fd,matrixOffset () + (size_t)w->numRows * w->numCols * typeSize (w->type)) != 0)
+    die ("error writing %s",w->fileName);
+  memset (h,0,sizeof (GctbHeader));
+  memcpy (h->magic,GCTB_MAGIC,8);
+  h->version = GCTB_VERSION;
+  h->type = w->type;
+  h->layout = w->layout;
+  h->numRows = w->numRows;
+  h->numCols = w->numCols;
+  h->matrixOffset = matrixOffset ();
+  writeSection (w,w->rowIds->base,w->numRows * sizeof (uint64_t),&h->rowIdsOffset);
+  writeSection (w,w->rowDescs->base,w->numRows * sizeof (uint64_t),&h->rowDescsOffset);
+  writeSection (w,w->colNames->base,w->numCols * sizeof (uint64_t),&h->colNamesOffset);
+  writeSection (w,w->strings->base,arrayMax (w->strings),&h->stringsOffset);
+  h->stringsSize = arrayMax (w->strings);
+  if (munmap (w->map,w->mapSize) != 0 || close (w->fd) != 0)
+    die ("error writing %s",w->fileName);
+  arrayDestroy (w->rowIds);
+  arrayDestroy (w->rowDescs);
+  arrayDestroy (w->colNames);
+  arrayDestroy (w->strings);
+  hlr_free (w->fileName);
+  free (w);
+}
@@ -0,0 +1,103 @@
+#ifndef GCTB_H
+#define GCTB_H
+
+/*
+  Binary companion format of GCT files (.gctb), written by gct2gctb and
+  the tools' binary outputs, read in place after mmap. The file is the
+  header followed by:
+    matrix     numRows x numCols values of type, row-major or
+               column-major, at a 64-byte aligned offset
+    rowIds     per row the offset of its id in strings (uint64)
+    rowDescs   per row the offset of its description in strings
+    colNames   per column the offset of its name in strings
+    strings    0-terminated strings
+  Missing values are NaN, or INT32_MIN for int32 matrices.
+  Integers and values are in host byte order.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "array.h"
+
+#define GCTB_MAGIC "GCTBINRY"
+#define GCTB_VERSION 1
+#define GCTB_ALIGN 64
+#define GCTB_INT32_NA INT32_MIN
+
+enum {GCTB_FLOAT32 = 1,GCTB_FLOAT64 = 2,GCTB_INT32 = 3};
+enum {GCTB_ROW_MAJOR = 0,GCTB_COL_MAJOR = 1};
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t type;
+  uint32_t layout;
+  uint32_t pad;
+  uint64_t numRows;
+  uint64_t numCols;
+  uint64_t matrixOffset;
+  uint64_t rowIdsOffset;
+  uint64_t rowDescsOffset;
+  uint64_t colNamesOffset;
+  uint64_t stringsOffset;
+  uint64_t stringsSize;
+} GctbHeader;
+
+/* reader */
+
+typedef struct {
+  char *map;
+  size_t size;
+  GctbHeader *header;
+  char *matrix;
+  uint64_t *rowIds;
+  uint64_t *rowDescs;
+  uint64_t *colNames;
+  char *strings;
+} GctbStruct,*Gctb;
+
+#define gctb_numRows(g) ((long)(g)->header->numRows)
+#define gctb_numCols(g) ((long)(g)->header->numCols)
+#define gctb_rowId(g,i) ((g)->strings + (g)->rowIds[i])
+#define gctb_rowDesc(g,i) ((g)->strings + (g)->rowDescs[i])
+#define gctb_colName(g,j) ((g)->strings + (g)->colNames[j])
+
+extern int gctb_isGctb (char *fileName);
+extern Gctb gctb_open (char *fileName);
+extern void gctb_close (Gctb g);
+extern double gctb_value (Gctb g,long i,long j);
+extern void gctb_row (Gctb g,long i,double *values);
+extern void gctb_writeValue (FILE *fp,double v,int type);
+extern void gctb_printRow (FILE *fp,char *id,char *desc,double *values,long numCols,int type);
+
+/* writer */
+
+typedef struct {
+  char *fileName;
+  int fd;
+  int type;
+  int layout;
+  long numRows;        /* -1 until gctb_finish if not known in advance */
+  long numCols;
+  long rowsAdded;
+  long colsAdded;
+  int grow;            /* numRows or numCols not known in advance */
+  long capacity;       /* rows (row-major) or columns (column-major) mapped */
+  char *map;           /* header and matrix */
+  size_t mapSize;
+  Array rowIds;        /* of uint64_t, offsets into strings */
+  Array rowDescs;
+  Array colNames;
+  Array strings;       /* of char */
+} GctbWriterStruct,*GctbWriter;
+
+extern int gctb_typeFromName (char *name);
+extern GctbWriter gctb_createWriter (char *fileName,long numRows,long numCols,int type,int layout);
+extern void gctb_setColName (GctbWriter w,long j,char *name);
+extern void gctb_setRowName (GctbWriter w,long i,char *id,char *desc);
+extern void gctb_addRow (GctbWriter w,char *id,char *desc,double *values);
+extern void gctb_addCol (GctbWriter w,char *name,double *values);
+extern void gctb_finish (GctbWriter w);
+
+#endif
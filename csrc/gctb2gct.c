@@ -0,0 +1,51 @@
+#include "format.h"
+#include "log.h"
+#include "arg.h"
+#include "gctb.h"
+
+#define AUTHOR_MAIL "roland.schmucki@roche.com"
+#define OUTPUT_BUFFER_SIZE 1048576
+
+
+void usagef (int level)
+{
+  romsg ("Description: \n"
+         "\n"
+         "Converts a binary GCT file (.gctb, see gct2gctb) into a text GCT file on \n"
+         "the standard output. Values are written with the fewest digits that read \n"
+         "back to the stored value; missing values are written as NA. \n"
+         "\n"
+         "Usage: %s GCTB_FILE \n"
+         "\n"
+         "Report bugs and feedback to %s \n",
+         arg_getProgName (),AUTHOR_MAIL);
+}
+
+
+
+int main (int argc,char *argv[])
+{
+  Gctb g;
+  double *values;
+  long i,j;
+
+  if (arg_init (argc,argv,"","",usagef) != argc - 1)
+    die ("wrong number of arguments; invoke program without params for help");
+  setvbuf (stdout,NULL,_IOFBF,OUTPUT_BUFFER_SIZE);
+  g = gctb_open (argv[argc-1]);
+  printf ("#1.2\n%ld\t%ld\nName\tDescription",gctb_numRows (g),gctb_numCols (g));
+  for (j=0;j<gctb_numCols (g);j++)
+    printf ("\t%s",gctb_colName (g,j));
+  putchar ('\n');
+  values = hlr_malloc ((gctb_numCols (g) + 1) * sizeof (double));
+  for (i=0;i<gctb_numRows (g);i++) {
+    gctb_row (g,i,values);
+    gctb_printRow (stdout,gctb_rowId (g,i),gctb_rowDesc (g,i),values,gctb_numCols (g),
+                   g->header->type);
+  }
+  hlr_free (values);
+  gctb_close (g);
+  if (fflush (stdout) != 0)
+    die ("error writing output");
+  return 0;
+}
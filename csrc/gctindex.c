@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "log.h"
+#include "hlrmisc.h"
+#include "array.h"
+#include "format.h"
+#include "gctindex.h"
+
+
+/* Returns the index file name of gctFileName (GCT_FILE.gcti), allocated */
+char *gcti_fileName (char *gctFileName)
+{
+  Stringa s = stringCreate (100);
+  char *fileName;
+
+  stringPrintf (s,"%s%s",gctFileName,GCTI_SUFFIX);
+  fileName = hlr_strdup (string (s));
+  stringDestroy (s);
+  return fileName;
+}
+
+
+/* ---------- writer ---------- */
+
+
+static char *sortStrings;
+
+static int orderRowsById (GctiRow *a,GctiRow *b)
+{
+  int c = strcmp (sortStrings + a->id,sortStrings + b->id);
+
+  if (c != 0)
+    return c;
+  return a->offset < b->offset ? -1 : a->offset > b->offset;
+}
+
+
+static uint64_t addString (Array strings,char *s,int len)
+{
+  uint64_t offset = arrayMax (strings);
+
+  arrayp (strings,offset + len,char);
+  memcpy (arrp (strings,offset,char),s,len);
+  arru (strings,offset + len,char) = '\0';
+  return offset;
+}
+
+
+static void writeSection (FILE *fp,void *data,size_t size,uint64_t *offset,char *fileName)
+{
+  static char zeros[8];
+  long pos = ftell (fp);
+  int pad = (8 - pos % 8) % 8;
+
+  if (fwrite (zeros,1,pad,fp) != pad ||
+      (size > 0 && fwrite (data,1,size,fp) != size))
+    die ("error writing %s",fileName);
+  *offset = pos + pad;
+}
+
+
+/*
+  Scans the mapped GCT file gctFileName and writes its row index to
+  indexFileName; dies if the file has less than 3 header lines
+*/
+void gcti_write (char *gctFileName,char *indexFileName)
+{
+  GctiHeader header;
+  Array rows = arrayCreate (100000,GctiRow);
+  Array colNames = arrayCreate (100,uint64_t);
+  Array strings = arrayCreate (1000000,char);
+  GctiRow *currRow;
+  struct stat st;
+  char *map = NULL;
+  char *s,*end,*eol,*tab,*field;
+  int fd,i,numLines = 0;
+  FILE *fp;
+
+  if ((fd = open (gctFileName,O_RDONLY)) < 0)
+    die ("cannot open %s",gctFileName);
+  if (fstat (fd,&st) != 0 || !S_ISREG (st.st_mode))
+    die ("%s is not a regular file",gctFileName);
+  if (st.st_size > 0 &&
+      (map = mmap (NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0)) == MAP_FAILED)
+    die ("cannot map %s",gctFileName);
+  close (fd);
+  if (map != NULL)
+    madvise (map,st.st_size,MADV_SEQUENTIAL);
+  memset (&header,0,sizeof (header));
+  addString (strings,"",0);
+  end = map + st.st_size;
+  for (s=map;s<end;s=eol + 1) {
+    if ((eol = memchr (s,'\n',end - s)) == NULL)
+      eol = end;
+    numLines++;
+    if (numLines == 3) {
+      /* sample names: fields 3 onwards */
+      i = 0;
+      for (field=s;field<=eol;field=tab + 1) {
+        if ((tab = memchr (field,'\t',eol - field)) == NULL)
+          tab = eol;
+        if (i++ >= 2)
+          array (colNames,arrayMax (colNames),uint64_t) = addString (strings,field,tab - field);
+      }
+      header.dataOffset = (eol < end ? eol + 1 : eol) - map;
+    }
+    if (numLines <= 3 || eol == s)
+      continue;
+    currRow = arrayp (rows,arrayMax (rows),GctiRow);
+    currRow->offset = s - map;
+    currRow->length = eol - s;
+    tab = memchr (s,'\t',eol - s);
+    currRow->id = addString (strings,s,(tab != NULL ? tab : eol) - s);
+  }
+  if (numLines < 3)
+    die ("%s: GCT header with less than 3 lines",gctFileName);
+  if (map != NULL)
+    munmap (map,st.st_size);
+  sortStrings = arrp (strings,0,char);
+  arraySort (rows,(ARRAYORDERF)orderRowsById);
+
+  memcpy (header.magic,GCTI_MAGIC,8);
+  header.version = GCTI_VERSION;
+  header.numRows = arrayMax (rows);
+  header.numCols = arrayMax (colNames);
+  header.gctSize = st.st_size;
+  header.gctMtime = st.st_mtim.tv_sec;
+  header.gctMtimeNsec = st.st_mtim.tv_nsec;
+  header.gctInode = st.st_ino;
+  fp = hlr_fopenWrite (indexFileName);
+  if (fwrite (&header,sizeof (header),1,fp) != 1)
+    die ("error writing %s",indexFileName);
+  writeSection (fp,rows->base,header.numRows * sizeof (GctiRow),&header.rowsOffset,indexFileName);
+  writeSection (fp,colNames->base,header.numCols * sizeof (uint64_t),
+                &header.colNamesOffset,indexFileName);
+  writeSection (fp,strings->base,arrayMax (strings),&header.stringsOffset,indexFileName);
+  header.stringsSize = arrayMax (strings);
+  if (fseek (fp,0,SEEK_SET) != 0 || fwrite (&header,sizeof (header),1,fp) != 1 ||
+      fclose (fp) != 0)
+    die ("error writing %s",indexFileName);
+  arrayDestroy (rows);
+  arrayDestroy (colNames);
+  arrayDestroy (strings);
+}
+
+
+/* ---------- reader ---------- */
+
+
+static void *section (GctIndex x,uint64_t offset,uint64_t n,size_t size,char *fileName)
+{
+  if (offset > x->size || n * size > x->size - offset)
+    die ("%s: section out of bounds",fileName);
+  return x->map + offset;
+}
+
+
+/*
+  Maps the index of GCT file gctFileName; returns NULL if there is none
+  or, with a warning, if it does not match the GCT file
+*/
+GctIndex gcti_open (char *gctFileName)
+{
+  GctIndex x;
+  GctiHeader *h;
+  struct stat st,gctSt;
+  char *fileName;
+  int fd;
+
+  if (strEqual (gctFileName,"-"))
+    return NULL;
+  fileName = gcti_fileName (gctFileName);
+  if ((fd = open (fileName,O_RDONLY)) < 0) {
+    hlr_free (fileName);
+    return NULL;
+  }
+  if (fstat (fd,&st) != 0 || st.st_size < sizeof (GctiHeader))
+    die ("%s is not a GCT index",fileName);
+  x = hlr_calloc (1,sizeof (GctIndexStruct));
+  x->size = st.st_size;
+  x->map = mmap (NULL,x->size,PROT_READ,MAP_SHARED,fd,0);
+  close (fd);
+  if (x->map == MAP_FAILED)
+    die ("cannot map %s",fileName);
+  h = x->header = (GctiHeader *)x->map;
+  if (memcmp (h->magic,GCTI_MAGIC,8) != 0)
+    die ("%s is not a GCT index",fileName);
+  if (h->version != GCTI_VERSION)
+    die ("%s: index version %u, expected %d; rebuild it with gct_index",
+         fileName,h->version,GCTI_VERSION);
+  if ((x->fd = open (gctFileName,O_RDONLY)) < 0)
+    die ("cannot open %s",gctFileName);
+  if (fstat (x->fd,&gctSt) != 0 || gctSt.st_size != h->gctSize ||
+      gctSt.st_mtim.tv_sec != h->gctMtime ||
+      gctSt.st_mtim.tv_nsec != h->gctMtimeNsec || gctSt.st_ino != h->gctInode) {
+    warn ("%s is out of date, not used; rebuild it with gct_index",fileName);
+    close (x->fd);
+    munmap (x->map,x->size);
+    free (x);
+    hlr_free (fileName);
+    return NULL;
+  }
+  x->rows = section (x,h->rowsOffset,h->numRows,sizeof (GctiRow),fileName);
+  x->colNames = section (x,h->colNamesOffset,h->numCols,sizeof (uint64_t),fileName);
+  x->strings = section (x,h->stringsOffset,h->stringsSize,1,fileName);
+  if (h->stringsSize == 0 || x->strings[h->stringsSize-1] != '\0')
+    die ("%s: invalid string section",fileName);
+  x->gctFileName = hlr_strdup (gctFileName);
+  hlr_free (fileName);
+  return x;
+}
+
+
+void gcti_close (GctIndex x)
+{
+  if (x == NULL)
+    return;
+  close (x->fd);
+  munmap (x->map,x->size);
+  hlr_free (x->gctFileName);
+  free (x);
+}
+
+
+/* compares the span id/len with the 0-terminated string s */
+static int compareId (char *id,int len,char *s)
+{
+  int c = strncmp (id,s,len);
+
+  if (c != 0)
+    return c;
+  return s[len] == '\0' ? 0 : -1;
+}
+
+
+/*
+  Returns the first row (in sort order) with id id of length len, or -1;
+  *count is set to the number of rows with this id
+*/
+long gcti_find (GctIndex x,char *id,int len,long *count)
+{
+  long lo = 0;
+  long hi = gcti_numRows (x);
+  long mid,first;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (compareId (id,len,gcti_rowId (x,mid)) > 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  first = lo;
+  while (lo < gcti_numRows (x) && compareId (id,len,gcti_rowId (x,lo)) == 0)
+    lo++;
+  *count = lo - first;
+  return *count > 0 ? first : -1;
+}
+
+
+/* Reads row i of the GCT file into buffer; returns the 0-terminated line */
+char *gcti_readRow (GctIndex x,long i,Stringa buffer)
+{
+  GctiRow *r = gcti_row (x,i);
+  ssize_t n;
+  size_t done = 0;
+
+  arrayp (buffer,r->length,char);
+  while (done < r->length) {
+    n = pread (x->fd,arrp (buffer,done,char),r->length - done,r->offset + done);
+    if (n <= 0)
+      die ("error reading %s",x->gctFileName);
+    done += n;
+  }
+  arru (buffer,r->length,char) = '\0';
+  arrayMax (buffer) = r->length + 1;
+  return string (buffer);
+}
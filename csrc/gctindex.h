@@ -0,0 +1,74 @@
+#ifndef GCTINDEX_H
+#define GCTINDEX_H
+
+/*
+  Row index of a text GCT file, written by gct_index next to the GCT
+  file (GCT_FILE.gcti). Rows are located by a binary search on the id
+  and read with pread, so a few rows of a huge file are read without a
+  scan. The file is the header followed by the sections below, each
+  8-byte aligned, and is used in place after mmap:
+    rows      per data row its offset and length (without the newline)
+              in the GCT file and its id, sorted by id, then offset
+    colNames  per sample the offset of its name in strings
+    strings   0-terminated strings
+  The size, modification time (with nanoseconds) and inode of the GCT
+  file are recorded; an index that does not match them is not used.
+  Integers are in host byte order.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "format.h"
+
+#define GCTI_MAGIC "GCTINDEX"
+#define GCTI_VERSION 2
+#define GCTI_SUFFIX ".gcti"
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t pad;
+  uint64_t numRows;
+  uint64_t numCols;
+  uint64_t gctSize;
+  int64_t gctMtime;
+  int64_t gctMtimeNsec;
+  uint64_t gctInode;
+  uint64_t dataOffset;        /* offset of the first data row in the GCT file */
+  uint64_t rowsOffset;
+  uint64_t colNamesOffset;
+  uint64_t stringsOffset;
+  uint64_t stringsSize;
+} GctiHeader;
+
+typedef struct {
+  uint64_t offset;
+  uint64_t length;
+  uint64_t id;                /* offset into strings */
+} GctiRow;
+
+typedef struct {
+  char *map;
+  size_t size;
+  GctiHeader *header;
+  GctiRow *rows;
+  uint64_t *colNames;
+  char *strings;
+  int fd;                     /* of the GCT file */
+  char *gctFileName;
+} GctIndexStruct,*GctIndex;
+
+#define gcti_numRows(x) ((long)(x)->header->numRows)
+#define gcti_numCols(x) ((long)(x)->header->numCols)
+#define gcti_row(x,i) ((x)->rows + (i))
+#define gcti_rowId(x,i) ((x)->strings + (x)->rows[i].id)
+#define gcti_colName(x,j) ((x)->strings + (x)->colNames[j])
+
+extern char *gcti_fileName (char *gctFileName);
+extern void gcti_write (char *gctFileName,char *indexFileName);
+extern GctIndex gcti_open (char *gctFileName);
+extern void gcti_close (GctIndex x);
+extern long gcti_find (GctIndex x,char *id,int len,long *count);
+extern char *gcti_readRow (GctIndex x,long i,Stringa buffer);
+
+#endif
@@ -0,0 +1,512 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "log.h"
+#include "hlrmisc.h"
+#include "array.h"
+#include "strhash.h"
+#include "gtfcache.h"
+
+
+/* ---------- reader ---------- */
+
+
+/* Returns 1 if fileName starts with the cache magic */
+int gtfc_isCache (char *fileName)
+{
+  FILE *fp;
+  char magic[8];
+  int ok;
+
+  if ((fp = fopen (fileName,"r")) == NULL)
+    return 0;
+  ok = fread (magic,1,8,fp) == 8 && memcmp (magic,GTFC_MAGIC,8) == 0;
+  fclose (fp);
+  return ok;
+}
+
+
+static void *section (GtfCache c,uint64_t offset,uint64_t n,size_t size)
+{
+  if (offset > c->size || n * size > c->size - offset)
+    die ("%s: section out of bounds","gtfc_open");
+  return c->map + offset;
+}
+
+
+/* Map a cache written by gtfc_write; dies on a missing or invalid file */
+GtfCache gtfc_open (char *fileName)
+{
+  GtfCache c;
+  GtfcHeader *h;
+  struct stat st;
+  int fd;
+
+  if ((fd = open (fileName,O_RDONLY)) < 0)
+    die ("cannot open %s",fileName);
+  if (fstat (fd,&st) != 0 || st.st_size < sizeof (GtfcHeader))
+    die ("%s is not an annotation cache",fileName);
+  c = hlr_calloc (1,sizeof (GtfCacheStruct));
+  c->size = st.st_size;
+  c->map = mmap (NULL,c->size,PROT_READ,MAP_SHARED,fd,0);
+  close (fd);
+  if (c->map == MAP_FAILED)
+    die ("cannot map %s",fileName);
+  h = c->header = (GtfcHeader *)c->map;
+  if (memcmp (h->magic,GTFC_MAGIC,8) != 0)
+    die ("%s is not an annotation cache",fileName);
+  if (h->version != GTFC_VERSION)
+    die ("%s: cache version %u, expected %d; recompile it with parse_gtf -compile",
+         fileName,h->version,GTFC_VERSION);
+  c->chroms = section (c,h->chromsOffset,h->nChroms,sizeof (GtfcChrom));
+  c->genes = section (c,h->genesOffset,h->nGenes,sizeof (GtfcGene));
+  c->genesById = section (c,h->genesByIdOffset,h->nGenes,sizeof (uint32_t));
+  c->transcripts = section (c,h->transcriptsOffset,h->nTranscripts,sizeof (GtfcTranscript));
+  c->exons = section (c,h->exonsOffset,h->nExons,sizeof (GtfcExon));
+  c->strings = section (c,h->stringsOffset,h->stringsSize,1);
+  if (h->stringsSize == 0 || c->strings[h->stringsSize-1] != '\0')
+    die ("%s: invalid string section",fileName);
+  return c;
+}
+
+
+void gtfc_close (GtfCache c)
+{
+  if (c == NULL)
+    return;
+  munmap (c->map,c->size);
+  free (c);
+}
+
+
+/* Returns the index of chromosome name, -1 if not present */
+int gtfc_findChrom (GtfCache c,char *name)
+{
+  int l = 0,r = c->header->nChroms - 1,x,v;
+
+  while (l <= r) {
+    x = (l + r) / 2;
+    v = strcmp (name,gtfc_string (c,c->chroms[x].name));
+    if (v == 0)
+      return x;
+    if (v < 0)
+      r = x - 1;
+    else
+      l = x + 1;
+  }
+  return -1;
+}
+
+
+/* Returns the index of the gene with id, -1 if not present */
+int gtfc_findGene (GtfCache c,char *id)
+{
+  int l = 0,r = c->header->nGenes - 1,x,v;
+
+  while (l <= r) {
+    x = (l + r) / 2;
+    v = strcmp (id,gtfc_string (c,c->genes[c->genesById[x]].id));
+    if (v == 0)
+      return c->genesById[x];
+    if (v < 0)
+      r = x - 1;
+    else
+      l = x + 1;
+  }
+  return -1;
+}
+
+
+/*
+  Collect the indices of all genes overlapping chrom:pos into hits
+  (Array of int, ascending). Returns the number of hits
+*/
+int gtfc_genesAt (GtfCache c,char *chrom,int pos,Array hits)
+{
+  GtfcChrom *currChrom;
+  int chr,l,r,x,i,n;
+
+  arrayClear (hits);
+  if ((chr = gtfc_findChrom (c,chrom)) < 0)
+    return 0;
+  currChrom = &c->chroms[chr];
+  // last gene starting at or before pos
+  l = currChrom->firstGene;
+  r = currChrom->firstGene + currChrom->nGenes - 1;
+  while (l <= r) {
+    x = (l + r) / 2;
+    if (c->genes[x].start <= pos)
+      l = x + 1;
+    else
+      r = x - 1;
+  }
+  for (i=r;i>=(int)currChrom->firstGene && c->genes[i].maxEnd >= pos;i--)
+    if (c->genes[i].end >= pos)
+      array (hits,arrayMax (hits),int) = i;
+  // ascending order
+  n = arrayMax (hits);
+  for (i=0;i<n/2;i++) {
+    x = arru (hits,i,int);
+    arru (hits,i,int) = arru (hits,n-1-i,int);
+    arru (hits,n-1-i,int) = x;
+  }
+  return n;
+}
+
+
+/* ---------- writer ---------- */
+
+
+GtfcBuilder gtfc_createBuilder (void)
+{
+  GtfcBuilder b = hlr_calloc (1,sizeof (GtfcBuilderStruct));
+
+  b->strings = strhash_create (100000);
+  strhash_add (b->strings,"",0); // id 0: missing value
+  b->geneIds = strhash_create (60000);
+  b->transcriptIds = strhash_create (250000);
+  b->genes = arrayCreate (60000,GtfcGene);
+  b->transcripts = arrayCreate (250000,GtfcTranscript);
+  b->exons = arrayCreate (1000000,GtfcExon);
+  return b;
+}
+
+
+void gtfc_destroyBuilder (GtfcBuilder b)
+{
+  strhash_destroy (b->strings);
+  strhash_destroy (b->geneIds);
+  strhash_destroy (b->transcriptIds);
+  arrayDestroy (b->genes);
+  arrayDestroy (b->transcripts);
+  arrayDestroy (b->exons);
+  arrayDestroy (b->chroms);
+  free (b->sortedGenes);
+  free (b->genesById);
+  free (b->stringData);
+  free (b);
+}
+
+
+/* Add one GTF record; records without gene id are ignored */
+void gtfc_add (GtfcBuilder b,GtfcRecord *r)
+{
+  GtfcGene *currGene;
+  GtfcTranscript *currTranscript;
+  GtfcExon *currExon;
+  int g,t;
+
+  if (r->geneId == NULL || r->geneIdLen == 0)
+    return;
+  g = strhash_add (b->geneIds,r->geneId,r->geneIdLen);
+  if (g == arrayMax (b->genes)) {
+    currGene = arrayp (b->genes,g,GtfcGene);
+    memset (currGene,0,sizeof (GtfcGene));
+    currGene->id = strhash_add (b->strings,r->geneId,r->geneIdLen);
+    currGene->chrom = strhash_add (b->strings,r->chrom,r->chromLen);
+    currGene->start = r->start;
+    currGene->end = r->end;
+    currGene->strand = r->strand;
+  }
+  currGene = arrp (b->genes,g,GtfcGene);
+  if (r->start < currGene->start)
+    currGene->start = r->start;
+  if (r->end > currGene->end)
+    currGene->end = r->end;
+  if (currGene->name == 0 && r->geneName != NULL && r->geneNameLen > 0)
+    currGene->name = strhash_add (b->strings,r->geneName,r->geneNameLen);
+  if (currGene->desc == 0 && r->desc != NULL && r->descLen > 0)
+    currGene->desc = strhash_add (b->strings,r->desc,r->descLen);
+
+  if (r->transcriptId == NULL || r->transcriptIdLen == 0)
+    return;
+  t = strhash_add (b->transcriptIds,r->transcriptId,r->transcriptIdLen);
+  if (t == arrayMax (b->transcripts)) {
+    currTranscript = arrayp (b->transcripts,t,GtfcTranscript);
+    memset (currTranscript,0,sizeof (GtfcTranscript));
+    currTranscript->id = strhash_add (b->strings,r->transcriptId,r->transcriptIdLen);
+    currTranscript->gene = g;
+    currTranscript->start = r->start;
+    currTranscript->end = r->end;
+  }
+  currTranscript = arrp (b->transcripts,t,GtfcTranscript);
+  if (r->start < currTranscript->start)
+    currTranscript->start = r->start;
+  if (r->end > currTranscript->end)
+    currTranscript->end = r->end;
+
+  if (!r->isExon)
+    return;
+  currExon = arrayp (b->exons,arrayMax (b->exons),GtfcExon);
+  currExon->transcript = t;
+  currExon->start = r->start;
+  currExon->end = r->end;
+}
+
+
+static GtfcBuilder sortBuilder; // for the order functions below
+static GtfcGene *sortGenes;
+
+static int orderGenesByCoord (int *a,int *b)
+{
+  GtfcGene *ga = arrp (sortBuilder->genes,*a,GtfcGene);
+  GtfcGene *gb = arrp (sortBuilder->genes,*b,GtfcGene);
+  int r = strcmp (strhash_key (sortBuilder->strings,ga->chrom),
+                  strhash_key (sortBuilder->strings,gb->chrom));
+  if (r != 0)
+    return r;
+  if (ga->start != gb->start)
+    return ga->start < gb->start ? -1 : 1;
+  if (ga->end != gb->end)
+    return ga->end < gb->end ? -1 : 1;
+  return strcmp (strhash_key (sortBuilder->strings,ga->id),
+                 strhash_key (sortBuilder->strings,gb->id));
+}
+
+static int orderGenesById (int *a,int *b)
+{
+  return strcmp (strhash_key (sortBuilder->strings,sortGenes[*a].id),
+                 strhash_key (sortBuilder->strings,sortGenes[*b].id));
+}
+
+static int orderTranscripts (GtfcTranscript *a,GtfcTranscript *b)
+{
+  if (a->gene != b->gene)
+    return a->gene < b->gene ? -1 : 1;
+  if (a->start != b->start)
+    return a->start < b->start ? -1 : 1;
+  if (a->end != b->end)
+    return a->end < b->end ? -1 : 1;
+  return strcmp (strhash_key (sortBuilder->strings,a->id),
+                 strhash_key (sortBuilder->strings,b->id));
+}
+
+static int orderExons (GtfcExon *a,GtfcExon *b)
+{
+  if (a->transcript != b->transcript)
+    return a->transcript < b->transcript ? -1 : 1;
+  if (a->start != b->start)
+    return a->start < b->start ? -1 : 1;
+  return a->end < b->end ? -1 : a->end > b->end;
+}
+
+static int orderExonsByStart (GtfcExon *a,GtfcExon *b)
+{
+  if (a->start != b->start)
+    return a->start < b->start ? -1 : 1;
+  return a->end < b->end ? -1 : a->end > b->end;
+}
+
+
+/* length of the union of exons, which is sorted by start */
+static uint32_t unionLength (Array exons)
+{
+  GtfcExon *currExon;
+  uint32_t len = 0;
+  int i,beg = 0,end = -1;
+
+  for (i=0;i<arrayMax (exons);i++) {
+    currExon = arrp (exons,i,GtfcExon);
+    if (currExon->start > end) {
+      if (end >= beg)
+        len += end - beg + 1;
+      beg = currExon->start;
+      end = currExon->end;
+    }
+    else if (currExon->end > end)
+      end = currExon->end;
+  }
+  if (end >= beg)
+    len += end - beg + 1;
+  return len;
+}
+
+
+static void writeSection (FILE *fp,void *data,size_t size,uint64_t *offset,char *fileName)
+{
+  static char zeros[8];
+  long pos = ftell (fp);
+  int pad = (8 - pos % 8) % 8;
+
+  if (fwrite (zeros,1,pad,fp) != pad ||
+      (size > 0 && fwrite (data,1,size,fp) != size))
+    die ("error writing %s",fileName);
+  *offset = pos + pad;
+}
+
+
+/*
+  Sort the collected records into the tables described in gtfcache.h:
+  b->chroms, b->sortedGenes, b->genesById, b->transcripts, b->exons and
+  b->stringData. Call once, no records can be added afterwards
+*/
+void gtfc_finish (GtfcBuilder b)
+{
+  int nGenes = arrayMax (b->genes);
+  int nTranscripts = arrayMax (b->transcripts);
+  int nStrings = strhash_count (b->strings);
+  Array order = arrayCreate (nGenes,int);
+  Array chroms = arrayCreate (100,GtfcChrom);
+  Array geneExons = arrayCreate (100,GtfcExon);
+  GtfcGene *genes = hlr_calloc (nGenes + 1,sizeof (GtfcGene));
+  uint32_t *genesById = hlr_calloc (nGenes + 1,sizeof (uint32_t));
+  int *newGene = hlr_calloc (nGenes + 1,sizeof (int));
+  int *newTranscript = hlr_calloc (nTranscripts + 1,sizeof (int));
+  uint32_t *stringOffset = hlr_calloc (nStrings + 1,sizeof (uint32_t));
+  GtfcGene *currGene;
+  GtfcTranscript *currTranscript;
+  GtfcExon *currExon;
+  GtfcChrom *currChrom = NULL;
+  int32_t maxEnd = 0;
+  int i,j,k;
+
+  sortBuilder = b;
+  for (i=0;i<nStrings;i++)
+    stringOffset[i+1] = stringOffset[i] + strhash_keyLen (b->strings,i) + 1;
+  b->stringsSize = stringOffset[nStrings];
+  b->stringData = hlr_malloc (b->stringsSize);
+  for (i=0;i<nStrings;i++)
+    memcpy (b->stringData + stringOffset[i],strhash_key (b->strings,i),
+            strhash_keyLen (b->strings,i) + 1);
+
+  /* genes by coordinate, chromosomes by name */
+  for (i=0;i<nGenes;i++)
+    array (order,i,int) = i;
+  arraySort (order,(ARRAYORDERF)orderGenesByCoord);
+  for (i=0;i<nGenes;i++) {
+    newGene[arru (order,i,int)] = i;
+    genes[i] = *arrp (b->genes,arru (order,i,int),GtfcGene);
+  }
+  for (i=0;i<nGenes;i++) {
+    currGene = &genes[i];
+    if (currChrom == NULL || currChrom->name != currGene->chrom) {
+      currChrom = arrayp (chroms,arrayMax (chroms),GtfcChrom);
+      currChrom->name = currGene->chrom;
+      currChrom->firstGene = i;
+      currChrom->nGenes = 0;
+      currChrom->pad = 0;
+      maxEnd = currGene->end;
+    }
+    currChrom->nGenes++;
+    if (currGene->end > maxEnd)
+      maxEnd = currGene->end;
+    currGene->maxEnd = maxEnd;
+    currGene->chrom = arrayMax (chroms) - 1;
+  }
+
+  /* transcripts by gene, exons by transcript */
+  for (i=0;i<nTranscripts;i++)
+    arrp (b->transcripts,i,GtfcTranscript)->gene = newGene[arrp (b->transcripts,i,GtfcTranscript)->gene];
+  for (i=0;i<nTranscripts;i++)
+    arrp (b->transcripts,i,GtfcTranscript)->firstExon = i; // old index
+  arraySort (b->transcripts,(ARRAYORDERF)orderTranscripts);
+  for (i=0;i<nTranscripts;i++)
+    newTranscript[arrp (b->transcripts,i,GtfcTranscript)->firstExon] = i;
+  for (i=0;i<arrayMax (b->exons);i++) {
+    currExon = arrp (b->exons,i,GtfcExon);
+    currExon->transcript = newTranscript[currExon->transcript];
+  }
+  arraySort (b->exons,(ARRAYORDERF)orderExons);
+  for (i=0;i<nTranscripts;i++) {
+    currTranscript = arrp (b->transcripts,i,GtfcTranscript);
+    currTranscript->firstExon = 0;
+    currTranscript->nExons = 0;
+  }
+  for (i=arrayMax (b->exons)-1;i>=0;i--) {
+    currTranscript = arrp (b->transcripts,arrp (b->exons,i,GtfcExon)->transcript,GtfcTranscript);
+    currTranscript->firstExon = i;
+    currTranscript->nExons++;
+  }
+  for (i=nTranscripts-1;i>=0;i--) {
+    currTranscript = arrp (b->transcripts,i,GtfcTranscript);
+    currGene = &genes[currTranscript->gene];
+    currGene->firstTranscript = i;
+    currGene->nTranscripts++;
+  }
+
+  /* exonic length of each gene: its exons are contiguous */
+  for (i=0;i<nGenes;i++) {
+    currGene = &genes[i];
+    arrayClear (geneExons);
+    for (j=0;j<currGene->nTranscripts;j++) {
+      currTranscript = arrp (b->transcripts,currGene->firstTranscript+j,GtfcTranscript);
+      for (k=0;k<currTranscript->nExons;k++)
+        array (geneExons,arrayMax (geneExons),GtfcExon) =
+          *arrp (b->exons,currTranscript->firstExon+k,GtfcExon);
+    }
+    arraySort (geneExons,(ARRAYORDERF)orderExonsByStart);
+    currGene->exonLength = unionLength (geneExons);
+  }
+
+  /* gene lookup by id */
+  for (i=0;i<nGenes;i++)
+    arru (order,i,int) = i;
+  sortGenes = genes;
+  arraySort (order,(ARRAYORDERF)orderGenesById);
+  for (i=0;i<nGenes;i++)
+    genesById[i] = arru (order,i,int);
+
+  /* string ids to offsets */
+  for (i=0;i<arrayMax (chroms);i++)
+    arrp (chroms,i,GtfcChrom)->name = stringOffset[arrp (chroms,i,GtfcChrom)->name];
+  for (i=0;i<nGenes;i++) {
+    genes[i].id = stringOffset[genes[i].id];
+    genes[i].name = stringOffset[genes[i].name];
+    genes[i].desc = stringOffset[genes[i].desc];
+  }
+  for (i=0;i<nTranscripts;i++) {
+    currTranscript = arrp (b->transcripts,i,GtfcTranscript);
+    currTranscript->id = stringOffset[currTranscript->id];
+  }
+
+  b->chroms = chroms;
+  b->sortedGenes = genes;
+  b->genesById = genesById;
+  b->finished = 1;
+  arrayDestroy (order);
+  arrayDestroy (geneExons);
+  free (newGene);
+  free (newTranscript);
+  free (stringOffset);
+}
+
+
+/* Write the tables to fileName; calls gtfc_finish if needed */
+void gtfc_write (GtfcBuilder b,char *fileName)
+{
+  GtfcHeader header;
+  FILE *fp;
+
+  if (!b->finished)
+    gtfc_finish (b);
+  memset (&header,0,sizeof (header));
+  memcpy (header.magic,GTFC_MAGIC,8);
+  header.version = GTFC_VERSION;
+  header.nChroms = arrayMax (b->chroms);
+  header.nGenes = arrayMax (b->genes);
+  header.nTranscripts = arrayMax (b->transcripts);
+  header.nExons = arrayMax (b->exons);
+  fp = hlr_fopenWrite (fileName);
+  if (fwrite (&header,sizeof (header),1,fp) != 1)
+    die ("error writing %s",fileName);
+  writeSection (fp,b->chroms->base,header.nChroms * sizeof (GtfcChrom),
+                &header.chromsOffset,fileName);
+  writeSection (fp,b->sortedGenes,header.nGenes * sizeof (GtfcGene),
+                &header.genesOffset,fileName);
+  writeSection (fp,b->genesById,header.nGenes * sizeof (uint32_t),
+                &header.genesByIdOffset,fileName);
+  writeSection (fp,b->transcripts->base,header.nTranscripts * sizeof (GtfcTranscript),
+                &header.transcriptsOffset,fileName);
+  writeSection (fp,b->exons->base,header.nExons * sizeof (GtfcExon),
+                &header.exonsOffset,fileName);
+  writeSection (fp,b->stringData,b->stringsSize,&header.stringsOffset,fileName);
+  header.stringsSize = b->stringsSize;
+  // header with the section offsets
+  if (fseek (fp,0,SEEK_SET) != 0 || fwrite (&header,sizeof (header),1,fp) != 1 ||
+      fclose (fp) != 0)
+    die ("error writing %s",fileName);
+}
@@ -0,0 +1,150 @@
+#ifndef GTFCACHE_H
+#define GTFCACHE_H
+
+/*
+  Compiled annotation cache, written by parse_gtf -compile.
+  The file is the header followed by the sections below, each 8-byte
+  aligned, and is used in place after mmap:
+    chroms       sorted by name
+    genes        sorted by chromosome, start, end; per chromosome a
+                 contiguous range (GtfcChrom.firstGene, nGenes)
+    genesById    gene indices sorted by gene id
+    transcripts  sorted by gene, start; contiguous per gene
+    exons        sorted by transcript, start; contiguous per transcript
+    strings      0-terminated strings, each stored once; all string
+                 fields are byte offsets into this section, 0 is ""
+  Coordinates are 1-based and inclusive as in the GTF.
+  Integers are in host byte order.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "array.h"
+#include "strhash.h"
+
+#define GTFC_MAGIC "GTFCACHE"
+#define GTFC_VERSION 1
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t nChroms;
+  uint32_t nGenes;
+  uint32_t nTranscripts;
+  uint32_t nExons;
+  uint32_t pad;
+  uint64_t chromsOffset;
+  uint64_t genesOffset;
+  uint64_t genesByIdOffset;
+  uint64_t transcriptsOffset;
+  uint64_t exonsOffset;
+  uint64_t stringsOffset;
+  uint64_t stringsSize;
+} GtfcHeader;
+
+typedef struct {
+  uint32_t name;
+  uint32_t firstGene;
+  uint32_t nGenes;
+  uint32_t pad;
+} GtfcChrom;
+
+typedef struct {
+  uint32_t id;
+  uint32_t name;
+  uint32_t desc;
+  uint32_t chrom;        /* index into chroms */
+  int32_t start;
+  int32_t end;
+  int32_t maxEnd;        /* largest end of the genes up to this one on the chromosome */
+  uint32_t exonLength;   /* length of the union of all exons */
+  uint32_t firstTranscript;
+  uint32_t nTranscripts;
+  char strand;
+  char pad[3];
+} GtfcGene;
+
+typedef struct {
+  uint32_t id;
+  uint32_t gene;
+  int32_t start;
+  int32_t end;
+  uint32_t firstExon;
+  uint32_t nExons;
+} GtfcTranscript;
+
+typedef struct {
+  uint32_t transcript;
+  int32_t start;
+  int32_t end;
+} GtfcExon;
+
+/* reader */
+
+typedef struct {
+  char *map;
+  size_t size;
+  GtfcHeader *header;
+  GtfcChrom *chroms;
+  GtfcGene *genes;
+  uint32_t *genesById;
+  GtfcTranscript *transcripts;
+  GtfcExon *exons;
+  char *strings;
+} GtfCacheStruct,*GtfCache;
+
+#define gtfc_string(c,offset) ((c)->strings + (offset))
+#define gtfc_nGenes(c) ((c)->header->nGenes)
+
+extern int gtfc_isCache (char *fileName);
+extern GtfCache gtfc_open (char *fileName);
+extern void gtfc_close (GtfCache c);
+extern int gtfc_findChrom (GtfCache c,char *name);
+extern int gtfc_findGene (GtfCache c,char *id);
+extern int gtfc_genesAt (GtfCache c,char *chrom,int pos,Array hits);
+
+/* writer */
+
+/* one GTF record; strings are spans, name/desc/transcriptId may be NULL */
+typedef struct {
+  char *chrom;
+  int chromLen;
+  int start;
+  int end;
+  char strand;
+  int isExon;
+  char *geneId;
+  int geneIdLen;
+  char *geneName;
+  int geneNameLen;
+  char *desc;
+  int descLen;
+  char *transcriptId;
+  int transcriptIdLen;
+} GtfcRecord;
+
+typedef struct {
+  StrHash strings;
+  StrHash geneIds;
+  StrHash transcriptIds;
+  Array genes;         /* of GtfcGene, by id in geneIds; strings are ids in strings */
+  Array transcripts;   /* of GtfcTranscript, by id in transcriptIds */
+  Array exons;         /* of GtfcExon */
+  /* filled by gtfc_finish, laid out as in the file */
+  int finished;
+  Array chroms;        /* of GtfcChrom */
+  GtfcGene *sortedGenes;
+  uint32_t *genesById;
+  char *stringData;
+  uint64_t stringsSize;
+} GtfcBuilderStruct,*GtfcBuilder;
+
+#define gtfc_builderString(b,offset) ((b)->stringData + (offset))
+
+extern GtfcBuilder gtfc_createBuilder (void);
+extern void gtfc_add (GtfcBuilder b,GtfcRecord *r);
+extern void gtfc_finish (GtfcBuilder b);
+extern void gtfc_write (GtfcBuilder b,char *fileName);
+extern void gtfc_destroyBuilder (GtfcBuilder b);
+
+#endif
@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "log.h"
+#include "hlrmisc.h"
+#include "format.h"
+#include "linereader.h"
+
+#define BLOCK_SIZE 4194304
+
+
+static LineReader create (char *fileName,int fd)
+{
+  LineReader lr = hlr_calloc (1,sizeof (LineReaderStruct));
+  struct stat st;
+
+  lr->fileName = hlr_strdup (fileName);
+  lr->fd = fd;
+  if (fstat (fd,&st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0) {
+    lr->mapSize = st.st_size;
+    lr->map = mmap (NULL,lr->mapSize,PROT_READ,MAP_PRIVATE,fd,0);
+    if (lr->map == MAP_FAILED)
+      lr->map = NULL;  /* read in blocks instead */
+    else {
+      madvise (lr->map,lr->mapSize,MADV_SEQUENTIAL);
+      lr->pos = lr->map;
+      lr->end = lr->map + lr->mapSize;
+      lr->eof = 1;
+      return lr;
+    }
+  }
+  lr->bufferSize = BLOCK_SIZE;
+  lr->buffer = hlr_malloc (lr->bufferSize);
+  lr->pos = lr->end = lr->buffer;
+  return lr;
+}
+
+
+
+/* Opens fileName, - for stdin; dies if the file cannot be opened */
+LineReader lr_createFromFile (char *fileName)
+{
+  int fd;
+
+  if (strEqual (fileName,"-"))
+    return create (fileName,0);
+  if ((fd = open (fileName,O_RDONLY)) < 0)
+    die ("cannot open %s",fileName);
+  return create (fileName,fd);
+}
+
+
+
+/* Reads the standard output of command (run by the shell) */
+LineReader lr_createFromPipe (char *command)
+{
+  LineReader lr;
+  FILE *fp;
+
+  if ((fp = popen (command,"r")) == NULL)
+    die ("cannot run %s",command);
+  lr = create (command,fileno (fp));
+  lr->pipe = fp;
+  return lr;
+}
+
+
+
+/*
+  Reads the next block behind the unread bytes, which are moved to the
+  start of the buffer; the buffer grows if a line does not fit. Returns
+  0 at the end of the input
+*/
+static int fill (LineReader lr)
+{
+  size_t keep = lr->end - lr->pos;
+  ssize_t n;
+  char *buffer;
+
+  if (lr->eof)
+    return 0;
+  if (keep == lr->bufferSize) {
+    buffer = hlr_malloc (2 * lr->bufferSize);
+    memcpy (buffer,lr->pos,keep);
+    hlr_free (lr->buffer);
+    lr->buffer = buffer;
+    lr->bufferSize *= 2;
+  }
+  else if (lr->pos != lr->buffer)
+    memmove (lr->buffer,lr->pos,keep);
+  lr->pos = lr->buffer;
+  lr->end = lr->buffer + keep;
+  while ((n = read (lr->fd,lr->end,lr->bufferSize - keep)) < 0)
+    if (errno != EINTR)
+      die ("error reading %s",lr->fileName);
+  if (n == 0) {
+    lr->eof = 1;
+    return 0;
+  }
+  lr->end += n;
+  return 1;
+}
+
+
+
+/* copies len bytes of line to lr->line, with room for 2 more bytes */
+static char *copyLine (LineReader lr,char *line,int len)
+{
+  if (len + 2 > lr->lineSize) {
+    hlr_free (lr->line);
+    lr->lineSize = len + 2 > 2 * lr->lineSize ? len + 2 : 2 * lr->lineSize;
+    lr->line = hlr_malloc (lr->lineSize);
+  }
+  memcpy (lr->line,line,len);
+  return lr->line;
+}
+
+
+
+/*
+  Returns the next line in place and sets *len to its length (without
+  the newline); the line is not 0-terminated and must not be changed,
+  but it is always followed by a newline, so parsers stopping at white
+  space do not read past it. Returns NULL at the end of the input
+*/
+char *lr_nextLineView (LineReader lr,int *len)
+{
+  char *line,*eol;
+  size_t scanned = 0;
+
+  for (;;) {
+    if ((eol = memchr (lr->pos + scanned,'\n',lr->end - lr->pos - scanned)) != NULL)
+      break;
+    scanned = lr->end - lr->pos;
+    if (!fill (lr)) {
+      if (lr->pos == lr->end)
+        return NULL;
+      /* last line without newline: copied to append one */
+      *len = lr->end - lr->pos;
+      line = copyLine (lr,lr->pos,*len);
+      line[*len] = '\n';
+      lr->pos = lr->end;
+      lr->count++;
+      return line;
+    }
+  }
+  line = lr->pos;
+  *len = eol - line;
+  lr->pos = eol + 1;
+  lr->count++;
+  return line;
+}
+
+
+
+/*
+  Returns the next line without its newline, 0-terminated; the line may
+  be changed and is valid until the next call. Returns NULL at the end
+  of the input
+*/
+char *lr_nextLine (LineReader lr)
+{
+  char *line;
+  int len;
+
+  if ((line = lr_nextLineView (lr,&len)) == NULL)
+    return NULL;
+  /* in the buffer (or already copied) the newline is replaced in place */
+  if (lr->map != NULL && line != lr->line)
+    line = copyLine (lr,line,len);
+  line[len] = '\0';
+  return line;
+}
+
+
+
+void lr_destroy_func (LineReader lr)
+{
+  if (lr == NULL)
+    return;
+  if (lr->map != NULL)
+    munmap (lr->map,lr->mapSize);
+  if (lr->pipe != NULL) {
+    if (pclose (lr->pipe) != 0)
+      warn ("%s failed",lr->fileName);
+  }
+  else if (lr->fd != 0)
+    close (lr->fd);
+  hlr_free (lr->buffer);
+  hlr_free (lr->line);
+  hlr_free (lr->fileName);
+  free (lr);
+}
@@ -0,0 +1,44 @@
+#ifndef LINEREADER_H
+#define LINEREADER_H
+
+/*
+  Line reader replacing the kernel LineStream for the tools' inputs.
+  Regular files (also on stdin) are mapped and scanned in place; pipes
+  and other streams are read in large blocks. Line ends are found with
+  memchr, which the C library implements with vector instructions.
+    lr_nextLine      the next line without its newline, 0-terminated and
+                     writable; valid until the next call
+    lr_nextLineView  the same line in place, not 0-terminated and
+                     read-only, without a copy; always followed by a
+                     newline; valid until the next call
+  Both return NULL at the end of the input.
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+
+typedef struct {
+  char *fileName;
+  int fd;
+  FILE *pipe;          /* lr_createFromPipe */
+  char *map;           /* mapped file, NULL if read in blocks */
+  size_t mapSize;
+  char *pos;           /* next unread byte of map or buffer */
+  char *end;
+  char *buffer;        /* blocks read from fd */
+  size_t bufferSize;
+  int eof;
+  char *line;          /* 0-terminated copy for lr_nextLine */
+  size_t lineSize;
+  int count;
+} LineReaderStruct,*LineReader;
+
+extern LineReader lr_createFromFile (char *fileName);
+extern LineReader lr_createFromPipe (char *command);
+extern char *lr_nextLineView (LineReader lr,int *len);
+extern char *lr_nextLine (LineReader lr);
+extern void lr_destroy_func (LineReader lr);
+#define lr_destroy(lr) (lr_destroy_func (lr),(lr)=NULL)
+#define lr_lineCountGet(lr) ((lr)->count)
+
+#endif
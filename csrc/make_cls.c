@@ -1,8 +1,10 @@
 #include <math.h>
 #include "format.h"
 #include "log.h"
-#include "linestream.h"
+#include "linereader.h"
 #include "arg.h"
+#include "strhash.h"
+#include "gct.h"
 
 #define AUTHOR_MAIL "roland.schmucki@roche.com"
 
@@ -46,43 +48,40 @@ int main (int argc,char *argv[])
   if (arg_init (argc,argv,"","gct i",usagef) != argc)
     die ("wrong number of arguments; invoke program without params for help");
   
-  LineStream ls;
+  LineReader ls;
   char *line;
   Texta it;
-  Stringa str = stringCreate (100);
-  int i,j;
-  Texta sampleNames = textCreate (1);
+  int i,j,id;
+  Texta sampleNames;
+  StrHash names;
+  int *firstSample;
   Array samples = arrayCreate (1,Sample);
   Sample *currSample;
   Texta tmp = textCreate (1);
   Texta groups = textCreate (1);
   char *prev;
 
-  stringPrintf (str,"head -3 %s",arg_get ("gct"));
-  ls = ls_createFromPipe (string (str));
-  while (line = ls_nextLine (ls)) {
-    if (ls_lineCountGet (ls) == 3) {
-      it = textStrtokP (line,"\t");
-      for (i=2;i<arrayMax (it);i++)
-        textAdd (sampleNames,textItem (it,i));
-      textDestroy (it);
-    }
-  }
-  ls_destroy (ls);
-
-  ls = ls_createFromFile (arg_get ("i"));
-  while (line = ls_nextLine (ls)) {
+  /* sample names from the gct header, hashed for the join */
+  sampleNames = gct_sampleNames (arg_get ("gct"));
+  names = strhash_create (arrayMax (sampleNames));
+  for (i=0;i<arrayMax (sampleNames);i++)
+    strhash_add (names,textItem (sampleNames,i),strlen (textItem (sampleNames,i)));
+  firstSample = hlr_malloc ((strhash_count (names) + 1) * sizeof (int));
+  for (i=0;i<strhash_count (names);i++)
+    firstSample[i] = -1;
+
+  ls = lr_createFromFile (arg_get ("i"));
+  while (line = lr_nextLine (ls)) {
     if (line[0] == '#')
       continue;
     it = textStrtokP (line,"\t");
     if (arrayMax (it) < 2)
       die ("missing fields in input file %s on line %s",arg_get ("i"),line);
     /* discard samples that are not in the gct file */
-    for (i=0;i<arrayMax (sampleNames);i++) {
-      if (strEqual (textItem (sampleNames,i),textItem (it,0)))
-        break;
-    }
-    if (i < arrayMax (sampleNames)) {
+    id = strhash_find (names,textItem (it,0),strlen (textItem (it,0)));
+    if (id >= 0) {
+      if (firstSample[id] < 0)
+        firstSample[id] = arrayMax (samples);
       currSample = arrayp (samples,arrayMax (samples),Sample);
       currSample->name = hlr_strdup (textItem (it,0));
       currSample->group = hlr_strdup (textItem (it,1));
@@ -91,7 +90,7 @@ int main (int argc,char *argv[])
     }
     textDestroy (it);
   }
-  ls_destroy (ls);
+  lr_destroy (ls);
 
   if (arrayMax (tmp) == 0) 
     die ("size of tmp = %d\n",arrayMax (tmp));
@@ -105,14 +104,11 @@ int main (int argc,char *argv[])
     prev = textItem (tmp,i);
   }
 
+  /* groups are sorted */
   for (i=0;i<arrayMax (samples);i++) {
     currSample = arrp (samples,i,Sample);
-    for (j=0;j<arrayMax (groups);j++) {
-      if (strEqual (textItem (groups,j),currSample->group)) {
-        currSample->index = j;
-        break;
-      }
-    }
+    if (arrayFind (groups,&currSample->group,&j,(ARRAYORDERF)arrayStrcmp))
+      currSample->index = j;
   }
 
   for (i=0;i<arrayMax (samples);i++) {
@@ -126,13 +122,10 @@ int main (int argc,char *argv[])
   printf ("\n");
 
   for (j=0;j<arrayMax (sampleNames);j++) {
-    for (i=0;i<arrayMax (samples);i++) {
-      currSample = arrp (samples,i,Sample);
-      if (strEqual (textItem (sampleNames,j),currSample->name))
-        break;
-    }
-    if (i == arrayMax (samples))
+    id = strhash_find (names,textItem (sampleNames,j),strlen (textItem (sampleNames,j)));
+    if (firstSample[id] < 0)
       die ("sample %s not found",textItem (sampleNames,j));
+    currSample = arrp (samples,firstSample[id],Sample);
     if (j > 0)
       printf (" ");
     printf ("%d",currSample->index);
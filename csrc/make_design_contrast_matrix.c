@@ -1,9 +1,11 @@
 #include <math.h>
 #include "format.h"
 #include "log.h"
-#include "linestream.h"
+#include "linereader.h"
 #include "arg.h"
 #include "rofutil.h"
+#include "strhash.h"
+#include "gct.h"
 
 #define AUTHOR_MAIL "roland.schmucki@roche.com"
 
@@ -14,12 +16,227 @@ typedef struct {
   int index;
 } Sample;
 
+/* annotation of gct sample name id with group index */
+typedef struct {
+  int name;
+  int group;
+} Pair;
+
+
+static int orderPairs (Pair *a,Pair *b)
+{
+  if (a->name != b->name)
+    return a->name - b->name;
+  return a->group - b->group;
+}
+
+
+/*
+  Dense writers: a row is a run of "\t0" cells with a few non-zero cells,
+  so each row is written as spans of a pre-built zero row and the
+  non-zero cells only
+*/
+static char *zeroRow = NULL;
+static long zeroCells = 0;
+
+static void writeZeros (FILE *fP,long n)
+{
+  while (n > zeroCells) {
+    fwrite (zeroRow,2,zeroCells,fP);
+    n -= zeroCells;
+  }
+  if (n > 0)
+    fwrite (zeroRow,2,n,fP);
+}
+
+
+
+static void createZeroRow (long n)
+{
+  long i;
+
+  if (n < 1)
+    n = 1;
+  zeroCells = n;
+  zeroRow = hlr_malloc (2 * n + 1);
+  for (i=0;i<n;i++) {
+    zeroRow[2*i] = '\t';
+    zeroRow[2*i+1] = '0';
+  }
+  zeroRow[2*n] = '\0';
+}
+
+
+
+/* contrast column of group pair i < j in a matrix of n groups */
+static long contrastColumn (long i,long j,long n)
+{
+  return i * n - i * (i + 1) / 2 + (j - i - 1);
+}
+
+
+
+static void writeDesignDense (char *fileName,Texta sampleNames,StrHash names,
+                              Texta groups,Array pairs,int *firstPair)
+{
+  FILE *fP;
+  int i,j,k,id,col;
+
+  fP = hlr_fopenWrite (fileName);
+  createZeroRow (arrayMax (groups));
+  for (i=0;i<arrayMax (groups);i++)
+    fprintf (fP,"\t%s",textItem (groups,i));
+  fputc ('\n',fP);
+  for (j=0;j<arrayMax (sampleNames);j++) {
+    fputs (textItem (sampleNames,j),fP);
+    id = strhash_find (names,textItem (sampleNames,j),strlen (textItem (sampleNames,j)));
+    col = 0;
+    for (k=firstPair[id];k<firstPair[id+1];k++) {
+      writeZeros (fP,arrp (pairs,k,Pair)->group - col);
+      fputs ("\t1",fP);
+      col = arrp (pairs,k,Pair)->group + 1;
+    }
+    writeZeros (fP,arrayMax (groups) - col);
+    fputc ('\n',fP);
+  }
+  fclose (fP);
+  hlr_free (zeroRow);
+}
+
+
+
+static void writeContrastDense (char *fileName,Texta groups)
+{
+  FILE *fP;
+  long i,j,k,col,next;
+  long n = arrayMax (groups);
+  long nCols = n * (n - 1) / 2;
+
+  fP = hlr_fopenWrite (fileName);
+  createZeroRow (n);
+  for (i=0;i<n;i++) {
+    for (j=i+1;j<n;j++)
+      fprintf (fP,"\t%s_vs_%s",textItem (groups,i),textItem (groups,j));
+  }
+  fputc ('\n',fP);
+  /* row k is -1 in columns (i,k) for i < k and 1 in columns (k,j) for j > k;
+     the 1s are contiguous, so at most n zero spans per row */
+  for (k=0;k<n;k++) {
+    fputs (textItem (groups,k),fP);
+    col = 0;
+    for (i=0;i<k;i++) {
+      next = contrastColumn (i,k,n);
+      writeZeros (fP,next - col);
+      fputs ("\t-1",fP);
+      col = next + 1;
+    }
+    if (k < n - 1) {
+      next = contrastColumn (k,k+1,n);
+      writeZeros (fP,next - col);
+      for (j=k+1;j<n;j++)
+        fputs ("\t1",fP);
+      col = next + n - k - 1;
+    }
+    writeZeros (fP,nCols - col);
+    fputc ('\n',fP);
+  }
+  fclose (fP);
+  hlr_free (zeroRow);
+}
+
+
+
+/*
+  Sparse writers: Matrix Market coordinate format with 1-based indices;
+  the row and column names go to FILE_rows.txt and FILE_cols.txt
+*/
+static void writeNames (char *fileName,char *suffix,Texta names)
+{
+  Stringa str = stringCreate (100);
+  FILE *fP;
+  int i;
+
+  stringPrintf (str,"%s_%s.txt",fileName,suffix);
+  fP = hlr_fopenWrite (string (str));
+  for (i=0;i<arrayMax (names);i++)
+    fprintf (fP,"%s\n",textItem (names,i));
+  fclose (fP);
+  stringDestroy (str);
+}
+
+
+
+static FILE *openMatrixMarket (char *fileName,long nRows,long nCols,long nonZeros)
+{
+  Stringa str = stringCreate (100);
+  FILE *fP;
+
+  stringPrintf (str,"%s.mtx",fileName);
+  fP = hlr_fopenWrite (string (str));
+  stringDestroy (str);
+  fprintf (fP,"%%%%MatrixMarket matrix coordinate integer general\n");
+  fprintf (fP,"%ld %ld %ld\n",nRows,nCols,nonZeros);
+  return fP;
+}
+
+
+
+static void writeDesignSparse (char *fileName,Texta sampleNames,StrHash names,
+                               Texta groups,Array pairs,int *firstPair)
+{
+  FILE *fP;
+  int j,k,id;
+  long nonZeros = 0;
+
+  for (j=0;j<arrayMax (sampleNames);j++) {
+    id = strhash_find (names,textItem (sampleNames,j),strlen (textItem (sampleNames,j)));
+    nonZeros += firstPair[id+1] - firstPair[id];
+  }
+  fP = openMatrixMarket (fileName,arrayMax (sampleNames),arrayMax (groups),nonZeros);
+  for (j=0;j<arrayMax (sampleNames);j++) {
+    id = strhash_find (names,textItem (sampleNames,j),strlen (textItem (sampleNames,j)));
+    for (k=firstPair[id];k<firstPair[id+1];k++)
+      fprintf (fP,"%d %d 1\n",j + 1,arrp (pairs,k,Pair)->group + 1);
+  }
+  fclose (fP);
+  writeNames (fileName,"rows",sampleNames);
+  writeNames (fileName,"cols",groups);
+}
+
+
+
+static void writeContrastSparse (char *fileName,Texta groups)
+{
+  FILE *fP;
+  long i,j,col;
+  long n = arrayMax (groups);
+  Texta contrasts = textCreate (n * (n - 1) / 2);
+  Stringa str = stringCreate (100);
+
+  fP = openMatrixMarket (fileName,n,n * (n - 1) / 2,n * (n - 1));
+  col = 1;
+  for (i=0;i<n;i++) {
+    for (j=i+1;j<n;j++) {
+      fprintf (fP,"%ld %ld 1\n%ld %ld -1\n",i + 1,col,j + 1,col);
+      stringPrintf (str,"%s_vs_%s",textItem (groups,i),textItem (groups,j));
+      textAdd (contrasts,string (str));
+      col++;
+    }
+  }
+  fclose (fP);
+  writeNames (fileName,"rows",groups);
+  writeNames (fileName,"cols",contrasts);
+  textDestroy (contrasts);
+  stringDestroy (str);
+}
+
+
 
 void usagef (int level)
 {
   romsg ("Description: \n"
          "\n"
-         "Usage: %s [-prefix STRING] -gct FILE -i FILE \n"
+         "Usage: %s [-prefix STRING] [-sparse] -gct FILE -i FILE \n"
          "\n"
          "Mandatory parameters: \n"
 	 "\n"
@@ -29,6 +246,9 @@ void usagef (int level)
          "Optional parameters: \n"
 	 "\n"
          "\t-prefix STRING        a string for the output prefix \n"
+         "\t-sparse               write both matrices in Matrix Market coordinate format: \n"
+         "\t                      PREFIX_designMatrix.mtx, PREFIX_contrastMatrix.mtx and \n"
+         "\t                      the row and column names in *_rows.txt and *_cols.txt \n"
          "\n"
          "\tThe annotation file is a 2 column tab-delimited file (comments or header mark with #) \n"
          "\t  column 1: sample name as given in input GCT file \n"
@@ -44,85 +264,93 @@ void usagef (int level)
 int main (int argc,char *argv[])
 {
 
-  if (arg_init (argc,argv,"prefix,1","gct i",usagef) != argc)
+  if (arg_init (argc,argv,"prefix,1 sparse,0","gct i",usagef) != argc)
     die ("wrong number of arguments; invoke program without params for help");
   
-  LineStream ls;
+  LineReader ls;
   char *line;
   Texta it;
   Stringa str = stringCreate (100);
-  int i,j,k;
-  Texta sampleNames = textCreate (1);
+  int i,k,id;
+  Texta sampleNames;
+  StrHash names;
+  StrHash groupNames = strhash_create (100);
+  int *firstPair;
   Array samples = arrayCreate (1,Sample);
+  Array pairs = arrayCreate (1,Pair);
   Sample *currSample;
-  Texta tmp = textCreate (1);
+  Pair *currPair;
   Texta groups = textCreate (1);
   char *prefix;
-  FILE *fP;
   char *designFile;
   char *contrastFile;
+  char *suffix = arg_present ("sparse") ? "" : ".txt";
  
   if (arg_present ("prefix")) {
     prefix = hlr_strdup (arg_get ("prefix"));
-    stringPrintf (str,"%s_designMatrix.txt",prefix);
+    stringPrintf (str,"%s_designMatrix%s",prefix,suffix);
     designFile = hlr_strdup (string (str));
-    stringPrintf (str,"%s_contrastMatrix.txt",prefix);
+    stringPrintf (str,"%s_contrastMatrix%s",prefix,suffix);
     contrastFile = hlr_strdup (string (str));
   }
   else {
-    designFile = hlr_strdup ("designMatrix.txt");
-    contrastFile = hlr_strdup ("contrastMatrix.txt");
-  }
-
-  // read gct header: samples
-  stringPrintf (str,"head -3 %s",arg_get ("gct"));
-  ls = ls_createFromPipe (string (str));
-  while (line = ls_nextLine (ls)) {
-    if (ls_lineCountGet (ls) == 3) {
-      it = textStrtokP (line,"\t");
-      for (i=2;i<arrayMax (it);i++)
-        textAdd (sampleNames,textItem (it,i));
-      textDestroy (it);
-    }
+    stringPrintf (str,"designMatrix%s",suffix);
+    designFile = hlr_strdup (string (str));
+    stringPrintf (str,"contrastMatrix%s",suffix);
+    contrastFile = hlr_strdup (string (str));
   }
-  ls_destroy (ls);
+
+  // read gct header: samples, hashed for the join
+  sampleNames = gct_sampleNames (arg_get ("gct"));
+  names = strhash_create (arrayMax (sampleNames));
+  for (i=0;i<arrayMax (sampleNames);i++)
+    strhash_add (names,textItem (sampleNames,i),strlen (textItem (sampleNames,i)));
 
   // read sample annotations
-  ls = ls_createFromFile (arg_get ("i"));
-  while (line = ls_nextLine (ls)) {
+  ls = lr_createFromFile (arg_get ("i"));
+  while (line = lr_nextLine (ls)) {
     if (line[0] == '#')
       continue;
     it = textStrtokP (line,"\t");
     if (arrayMax (it) < 2)
       die ("missing fields in input file %s on line %s",arg_get ("i"),line);
     /* discard samples that are not in the gct file */
-    for (i=0;i<arrayMax (sampleNames);i++) {
-      if (strEqual (textItem (sampleNames,i),textItem (it,0)))
-        break;
-    }
-    if (i < arrayMax (sampleNames)) {
+    id = strhash_find (names,textItem (it,0),strlen (textItem (it,0)));
+    if (id >= 0) {
       currSample = arrayp (samples,arrayMax (samples),Sample);
       currSample->name = hlr_strdup (textItem (it,0));
       currSample->group = hlr_strdup (textItem (it,1));
-      currSample->index = -1;
-      textAdd (tmp,textItem (it,1));
+      /* groups in order of appearance */
+      currSample->index = strhash_add (groupNames,currSample->group,strlen (currSample->group));
+      if (currSample->index == arrayMax (groups))
+        textAdd (groups,currSample->group);
+      currPair = arrayp (pairs,arrayMax (pairs),Pair);
+      currPair->name = id;
+      currPair->group = currSample->index;
     }
     textDestroy (it);
   }
-  ls_destroy (ls);
+  lr_destroy (ls);
 
-  if (arrayMax (tmp) == 0) 
-    die ("size of tmp = %d\n",arrayMax (tmp));
+  if (arrayMax (samples) == 0) 
+    die ("size of tmp = %d\n",arrayMax (samples));
 
-  textAdd (groups,textItem (tmp,0));
-  for (i=1;i<arrayMax (tmp);i++) {
-    for (j=0;j<arrayMax (groups);j++) {
-      if (strEqual (textItem (groups,j),textItem (tmp,i)))
-        break;
-    }
-    if (j==arrayMax (groups))
-      textAdd (groups,textItem (tmp,i));
+  /* annotations per gct sample name: pairs firstPair[id] .. firstPair[id+1]-1 */
+  arraySort (pairs,(ARRAYORDERF)orderPairs);
+  /* de-duplicate annotations of the same sample with the same group */
+  k = 0;
+  for (i=0;i<arrayMax (pairs);i++) {
+    if (k > 0 && orderPairs (arrp (pairs,k-1,Pair),arrp (pairs,i,Pair)) == 0)
+      continue;
+    array (pairs,k,Pair) = arru (pairs,i,Pair);
+    k++;
   }
+  arrayMax (pairs) = k;
+  firstPair = hlr_calloc (strhash_count (names) + 1,sizeof (int));
+  for (i=0;i<arrayMax (pairs);i++)
+    firstPair[arrp (pairs,i,Pair)->name + 1]++;
+  for (i=0;i<strhash_count (names);i++)
+    firstPair[i+1] += firstPair[i];
  
 
 /*  arraySort (tmp,(ARRAYORDERF)arrayStrcmp);
@@ -149,50 +377,14 @@ int main (int argc,char *argv[])
 //    romsg ("%s\t%s\t%d",currSample->name,currSample->group,currSample->index);
 //  }
 
-  // output designMatrix
-  fP =  hlr_fopenWrite (designFile);
-  for (i=0;i<arrayMax (groups);i++)
-   fprintf (fP,"\t%s",textItem (groups,i));
-  fprintf (fP,"\n");
-  for (j=0;j<arrayMax (sampleNames);j++) {
-    fprintf (fP,"%s",textItem (sampleNames,j));
-    for (i=0;i<arrayMax (groups);i++) {
-      for (k=0;k<arrayMax (samples);k++) {
-        currSample = arrp (samples,k,Sample);
-        if ( strEqual (textItem (sampleNames,j),currSample->name) && strEqual (textItem (groups,i),currSample->group)) {
-          fprintf (fP,"\t1");
-          break;
-        }
-      }
-      if (k == arrayMax (samples))
-        fprintf (fP,"\t0");
-    }
-    fprintf (fP,"\n");
-  }
-  fclose (fP);
 
-  // output contrastMatrix
-  fP =  hlr_fopenWrite (contrastFile);
-  for (i=0;i<arrayMax (groups);i++) {
-    for (j=i+1;j<arrayMax (groups);j++)
-      fprintf (fP,"\t%s_vs_%s",textItem (groups,i),textItem (groups,j));
+  if (arg_present ("sparse")) {
+    writeDesignSparse (designFile,sampleNames,names,groups,pairs,firstPair);
+    writeContrastSparse (contrastFile,groups);
   }
-  fprintf (fP,"\n");
-  for (k=0;k<arrayMax (groups);k++) {
-    fprintf (fP,"%s",textItem (groups,k));
-
-    for (i=0;i<arrayMax (groups);i++) {
-      for (j=i+1;j<arrayMax (groups);j++) {
-        if (strEqual (textItem (groups,k),textItem (groups,i)))
-          fprintf (fP,"\t1");
-        else if (strEqual (textItem (groups,k),textItem (groups,j)))
-          fprintf (fP,"\t-1");
-        else
-          fprintf (fP,"\t0");
-      }
-    }
-    fprintf (fP,"\n");
+  else {
+    writeDesignDense (designFile,sampleNames,names,groups,pairs,firstPair);
+    writeContrastDense (contrastFile,groups);
   }
-  fclose (fP);
   return 0;
 }
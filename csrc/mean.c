@@ -1,21 +1,59 @@
 #include <math.h>
+#include <pthread.h>
 #include "format.h"
 #include "log.h"
-#include "linestream.h"
+#include "linereader.h"
 #include "arg.h"
+#include "strhash.h"
 
 #define AUTHOR_MAIL "roland.schmucki@roche.com"
 #define COLS 5
+#define OUTPUT_BUFFER_SIZE 1048576
+#define BLOCK_LINES 256       /* data lines per thread and round */
 
 
 typedef struct {
   char *id;
-  char *group;
+  Texta annotations;  /* columns of the SAMPLE_ANNOTATIONS line */
   //int libSize;
-  int groupIndex;
-  int colIndex;
+  int colIndex;    /* column in INFILE, -1 if not in the header */
+  int sameId;      /* next sample with the same id, -1 if none */
 } Sample;
 
+/* grouping of the samples by one annotation column or a combination */
+typedef struct {
+  char *name;      /* e.g. "2" or "2x3" */
+  Array cols;      /* of int, annotation columns (0-based) */
+  Texta groups;
+  int *sampleGroup;  /* group index per sample */
+  int *groupStart;   /* slots of group j: groupStart[j] .. groupStart[j+1]-1 */
+  int *slotValue;    /* slot -> index into the parsed values of a row */
+  FILE *fp;
+} Factor;
+
+/* data lines processed by one thread */
+typedef struct {
+  char *buffer;      /* the lines, each 0-terminated */
+  size_t len;
+  size_t size;
+  Array lines;       /* of size_t, offsets into buffer */
+  Stringa *outs;     /* output per factor */
+  double *values;
+  double *grouped;
+  double *sorted;
+} Block;
+
+enum {STAT_MEAN,STAT_SD,STAT_MEDIAN,STAT_MIN,STAT_MAX,STAT_NONZERO,STAT_NUM};
+static char *statNames[STAT_NUM] = {"mean","sd","median","min","max","nonzero"};
+
+static Array samples; // of Sample
+static Array factors; // of Factor
+static int *usedCols = NULL;  // sorted INFILE columns that are parsed
+static int numUsed = 0;
+static int stats[STAT_NUM];
+static int numStats = 0;
+static int skipCols = COLS;
+
 
 void usagef (int level)
 {
@@ -23,7 +61,7 @@ void usagef (int level)
          "\n"
 	 "Calculate means per sample conditions. \n"
          "\n"
-         "Usage: %s [-skip INT] [-gzip]  -i INFILE  -s SAMPLE_ANNOTATIONS \n"
+         "Usage: %s [-skip INT] [-gzip] [-stats LIST] [-factors LIST -o PREFIX]  -i INFILE  -s SAMPLE_ANNOTATIONS \n"
 	 "\n"
 	 "Mandatory parameters: \n"
 	 "\t  -i FILE  inptu file with sample data, e.g. read counts \n"
@@ -42,139 +80,526 @@ void usagef (int level)
          "\t  -skip INT     denotes how many columns from the INFILE should be skipped and \n"
 	 "\t                not used for calculation, e.g. skip ID or description columns, default %d \n"
 	 "\t  -gzip         use if INFILE is gzipped\n"
-	 "\n" 
+	 "\t  -stats LIST   comma-separated statistics per sample condition, computed in one pass, \n"
+	 "\t                from mean,sd,median,min,max,nonzero (default mean). With more than \n"
+	 "\t                mean the output columns are named CONDITION_STAT, grouped by statistic \n"
+	 "\t  -factors LIST comma-separated SAMPLE_ANNOTATIONS columns to group by (default 2); \n"
+	 "\t                columns joined by ':' group by their combination, \n"
+	 "\t                e.g. 2,3,2:3 for treatment, timepoint and treatment x timepoint. \n"
+	 "\t                INFILE is read once for all factors \n"
+	 "\t  -o PREFIX     with several factors, write the output of factor 2:3 \n"
+	 "\t                to PREFIX.2x3.txt etc. instead of stdout \n"
+	 "\t  -threads N    parse and aggregate blocks of lines on N threads (default 1); \n"
+	 "\t                the output is in input order \n"
+	 "\n"
          "Report bugs and feedback to %s \n",
          arg_getProgName (),COLS+1, AUTHOR_MAIL);
 }
 
 
+static int orderInts (int *a,int *b)
+{
+  return *a - *b;
+}
+
+
+static int orderDoubles (const void *a,const void *b)
+{
+  double x = *(double *)a;
+  double y = *(double *)b;
+  return x < y ? -1 : x > y;
+}
+
+
+/* parse -factors, e.g. "2,3,2:3" */
+static void createFactors (char *spec)
+{
+  Texta it,it1;
+  Factor *currFactor;
+  Stringa name = stringCreate (20);
+  int i,j,col;
+
+  factors = arrayCreate (5,Factor);
+  it = textFieldtokP (spec,",");
+  for (i=0;i<arrayMax (it);i++) {
+    currFactor = arrayp (factors,arrayMax (factors),Factor);
+    currFactor->cols = arrayCreate (2,int);
+    stringClear (name);
+    it1 = textFieldtokP (textItem (it,i),":");
+    for (j=0;j<arrayMax (it1);j++) {
+      col = atoi (textItem (it1,j));
+      if (col < 2)
+        die ("invalid column %s in -factors; sample conditions start in column 2",
+             textItem (it1,j));
+      array (currFactor->cols,arrayMax (currFactor->cols),int) = col - 1;
+      stringAppendf (name,"%s%d",j > 0 ? "x" : "",col);
+    }
+    textDestroy (it1);
+    currFactor->name = hlr_strdup (string (name));
+    currFactor->groups = textCreate (10);
+    currFactor->sampleGroup = hlr_calloc (arrayMax (samples) + 1,sizeof (int));
+    currFactor->fp = stdout;
+  }
+  textDestroy (it);
+  stringDestroy (name);
+}
+
+
+/*
+  Assign every sample to a group of each factor, groups in order of
+  appearance; the group of a combination is named by its values joined by "_"
+*/
+static void assignGroups (void)
+{
+  Factor *currFactor;
+  Sample *currSample;
+  StrHash groupNames;
+  Stringa group = stringCreate (20);
+  int f,i,j,col;
+
+  for (f=0;f<arrayMax (factors);f++) {
+    currFactor = arrp (factors,f,Factor);
+    groupNames = strhash_create (100);
+    for (i=0;i<arrayMax (samples);i++) {
+      currSample = arrp (samples,i,Sample);
+      stringClear (group);
+      for (j=0;j<arrayMax (currFactor->cols);j++) {
+        col = arru (currFactor->cols,j,int);
+        if (col >= arrayMax (currSample->annotations))
+          die ("sample %s has no annotation in column %d",currSample->id,col + 1);
+        stringAppendf (group,"%s%s",j > 0 ? "_" : "",textItem (currSample->annotations,col));
+      }
+      currFactor->sampleGroup[i] = strhash_add (groupNames,string (group),stringLen (group));
+      if (currFactor->sampleGroup[i] == arrayMax (currFactor->groups))
+        textAdd (currFactor->groups,string (group));
+    }
+    strhash_destroy (groupNames);
+  }
+  stringDestroy (group);
+}
+
+
+/* sorted INFILE columns of all samples found in the header */
+static void findUsedColumns (void)
+{
+  Array cols = arrayCreate (arrayMax (samples),int);
+  Sample *currSample;
+  int i;
+
+  for (i=0;i<arrayMax (samples);i++) {
+    currSample = arrp (samples,i,Sample);
+    if (currSample->colIndex >= 0)
+      array (cols,arrayMax (cols),int) = currSample->colIndex;
+  }
+  arraySort (cols,(ARRAYORDERF)orderInts);
+  hlr_free (usedCols);
+  usedCols = hlr_malloc ((arrayMax (cols) + 1) * sizeof (int));
+  numUsed = 0;
+  for (i=0;i<arrayMax (cols);i++)
+    if (numUsed == 0 || usedCols[numUsed-1] != arru (cols,i,int))
+      usedCols[numUsed++] = arru (cols,i,int);
+  arrayDestroy (cols);
+}
+
+
+/*
+  Assign a slot to every sample: slots of one group are contiguous, so the
+  values of a group can be reduced with plain loops over a range
+*/
+static void buildSlots (Factor *currFactor)
+{
+  Sample *currSample;
+  int numGroups = arrayMax (currFactor->groups);
+  int i,j,s,l,r,x;
+  int counts[numGroups + 1];
+
+  for (j=0;j<=numGroups;j++)
+    counts[j] = 0;
+  for (i=0;i<arrayMax (samples);i++)
+    counts[currFactor->sampleGroup[i] + 1]++;
+  hlr_free (currFactor->groupStart);
+  currFactor->groupStart = hlr_malloc ((numGroups + 1) * sizeof (int));
+  currFactor->groupStart[0] = 0;
+  for (j=1;j<=numGroups;j++)
+    currFactor->groupStart[j] = currFactor->groupStart[j-1] + counts[j];
+  hlr_free (currFactor->slotValue);
+  currFactor->slotValue = hlr_malloc ((arrayMax (samples) + 1) * sizeof (int));
+  for (j=0;j<numGroups;j++)
+    counts[j] = currFactor->groupStart[j];
+  for (i=0;i<arrayMax (samples);i++) {
+    currSample = arrp (samples,i,Sample);
+    s = counts[currFactor->sampleGroup[i]]++;
+    // samples missing in the header read the constant 0 after the used columns
+    currFactor->slotValue[s] = numUsed;
+    if (currSample->colIndex >= 0) {
+      l = 0;
+      r = numUsed - 1;
+      while (l < r) {
+        x = (l + r) / 2;
+        if (usedCols[x] < currSample->colIndex)
+          l = x + 1;
+        else
+          r = x;
+      }
+      currFactor->slotValue[s] = l;
+    }
+  }
+}
+
+
+/* sum with independent partial sums, so the loop vectorizes */
+static double sumRange (double *x,int n)
+{
+  double s0 = 0.,s1 = 0.,s2 = 0.,s3 = 0.;
+  int i;
+
+  for (i=0;i+3<n;i+=4) {
+    s0 += x[i];
+    s1 += x[i+1];
+    s2 += x[i+2];
+    s3 += x[i+3];
+  }
+  for (;i<n;i++)
+    s0 += x[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
+
+/*
+  Parse the sample columns of one data line into values (numUsed+1
+  doubles). Returns the length of the passthrough columns 0..skipCols
+*/
+static int parseLine (char *line,double *values)
+{
+  char *pos = line;
+  char *end = line;
+  int col = 0,i,k;
+
+  /* passthrough columns 0..skipCols as they are */
+  for (i=0;i<skipCols;i++) {
+    if ((end = strchr (end,'\t')) == NULL)
+      die ("too few columns on line %s",line);
+    end++;
+  }
+  if ((end = strchr (end,'\t')) == NULL)
+    end = line + strlen (line);
+
+  /* values of the sample columns */
+  pos = line;
+  for (k=0;k<numUsed;k++) {
+    while (col < usedCols[k]) {
+      if ((pos = strchr (pos,'\t')) == NULL)
+        die ("array size problem line=%s\nindex=%d\n",line,usedCols[k]);
+      pos++;
+      col++;
+    }
+    values[k] = atof (pos);
+  }
+  values[numUsed] = 0.;
+  return end - line;
+}
+
+
+/*
+  Append the output line of currFactor to out: the passthrough columns
+  (first passLen bytes of line) and the statistics per group.
+  grouped and sorted are scratch arrays of arrayMax (samples)+1 doubles
+*/
+static void aggregate (Factor *currFactor,char *line,int passLen,double *values,
+                       Stringa out,double *grouped,double *sorted)
+{
+  int *groupStart = currFactor->groupStart;
+  int i,j,k,n,nonZero;
+  double *x,sum,mean,d,v;
+
+  stringAppendf (out,"%.*s",passLen,line);
+  for (i=0;i<arrayMax (samples);i++)
+    grouped[i] = values[currFactor->slotValue[i]];
+
+  for (k=0;k<numStats;k++) {
+    for (j=0;j<arrayMax (currFactor->groups);j++) {
+      x = grouped + groupStart[j];
+      n = groupStart[j+1] - groupStart[j];
+      switch (stats[k]) {
+      case STAT_MEAN:
+        stringAppendf (out,"\t%.6f",sumRange (x,n) / n);
+        break;
+      case STAT_SD:
+        mean = sumRange (x,n) / n;
+        sum = 0.;
+        for (i=0;i<n;i++) {
+          d = x[i] - mean;
+          sum += d * d;
+        }
+        stringAppendf (out,"\t%.6f",n > 1 ? sqrt (sum / (n - 1)) : NAN);
+        break;
+      case STAT_MEDIAN:
+        memcpy (sorted,x,n * sizeof (double));
+        qsort (sorted,n,sizeof (double),orderDoubles);
+        v = n % 2 == 1 ? sorted[n/2] : (sorted[n/2-1] + sorted[n/2]) / 2;
+        stringAppendf (out,"\t%.6f",v);
+        break;
+      case STAT_MIN:
+        v = x[0];
+        for (i=1;i<n;i++)
+          v = x[i] < v ? x[i] : v;
+        stringAppendf (out,"\t%.6f",v);
+        break;
+      case STAT_MAX:
+        v = x[0];
+        for (i=1;i<n;i++)
+          v = x[i] > v ? x[i] : v;
+        stringAppendf (out,"\t%.6f",v);
+        break;
+      case STAT_NONZERO:
+        nonZero = 0;
+        for (i=0;i<n;i++)
+          nonZero += x[i] != 0.;
+        stringAppendf (out,"\t%d",nonZero);
+        break;
+      }
+    }
+  }
+  stringCatChar (out,'\n');
+}
+
+
+/* thread function: parse and aggregate all lines of a block */
+static void *processBlock (void *arg)
+{
+  Block *b = arg;
+  char *line;
+  int i,f,passLen;
+
+  for (f=0;f<arrayMax (factors);f++)
+    stringClear (b->outs[f]);
+  for (i=0;i<arrayMax (b->lines);i++) {
+    line = b->buffer + arru (b->lines,i,size_t);
+    passLen = parseLine (line,b->values);
+    for (f=0;f<arrayMax (factors);f++)
+      aggregate (arrp (factors,f,Factor),line,passLen,b->values,b->outs[f],
+                 b->grouped,b->sorted);
+  }
+  return NULL;
+}
+
+
+/* process blocks 0..n-1 in parallel and write their output in order */
+static void processBlocks (Block *blocks,int n)
+{
+  pthread_t tids[n];
+  Factor *currFactor;
+  int i,f;
+
+  if (n == 1)
+    processBlock (&blocks[0]);
+  else {
+    for (i=0;i<n;i++)
+      if (pthread_create (&tids[i],NULL,processBlock,&blocks[i]) != 0)
+        die ("cannot create thread");
+    for (i=0;i<n;i++)
+      pthread_join (tids[i],NULL);
+  }
+  for (i=0;i<n;i++) {
+    for (f=0;f<arrayMax (factors);f++) {
+      currFactor = arrp (factors,f,Factor);
+      if (fwrite (string (blocks[i].outs[f]),1,stringLen (blocks[i].outs[f]),currFactor->fp) !=
+          stringLen (blocks[i].outs[f]))
+        die ("error writing output");
+    }
+    blocks[i].len = 0;
+    arrayClear (blocks[i].lines);
+  }
+}
+
 
 int main (int argc,char *argv[])
 {
 
-  if (arg_init (argc,argv,"gzip,0 skip,1","i s",usagef) != argc)
+  if (arg_init (argc,argv,"gzip,0 skip,1 stats,1 factors,1 o,1 threads,1","i s",usagef) != argc)
     die ("wrong number of arguments; invoke program without params for help");
 
-  
-  LineStream ls;
+
+  LineReader ls;
   char *line;
   Texta it;
-  Texta groups;
-  int i,j;
-  Array samples = arrayCreate (1,Sample);
+  int i,j,k,f,index,len;
+  int haveHeader = 0;
+  int threads,numBlocks = 0;
   Sample *currSample;
-  int skipCols = COLS;
+  Factor *currFactor;
   Stringa str = stringCreate (100);
-  
-  if (arg_present ("skip")) 
+  StrHash sampleIds = strhash_create (1000);
+  static char outputBuffer[OUTPUT_BUFFER_SIZE];
+  Block *currBlock;
+  int seen[STAT_NUM] = {0};
+
+  samples = arrayCreate (1,Sample);
+  if (arg_present ("skip"))
     skipCols = atoi (arg_get ("skip")) - 1;
-    
+  threads = arg_present ("threads") ? atoi (arg_get ("threads")) : 1;
+  if (threads < 1)
+    die ("-threads must be at least 1");
+
+  /* statistics */
+  it = textFieldtokP (arg_present ("stats") ? arg_get ("stats") : "mean",",");
+  for (i=0;i<arrayMax (it);i++) {
+    for (k=0;k<STAT_NUM;k++)
+      if (strEqual (textItem (it,i),statNames[k]))
+        break;
+    if (k == STAT_NUM)
+      die ("unknown statistic %s in -stats",textItem (it,i));
+    if (seen[k])
+      die ("duplicate statistic %s in -stats",statNames[k]);
+    seen[k] = 1;
+    stats[numStats++] = k;
+  }
+  textDestroy (it);
+
 
   /* sample annotation file */
-  groups = textCreate (1);
-  ls = ls_createFromFile (arg_get ("s"));
-  while (line = ls_nextLine (ls)) {
+  ls = lr_createFromFile (arg_get ("s"));
+  while (line = lr_nextLine (ls)) {
     it = textStrtokP (line,"\t");
     currSample = arrayp (samples,arrayMax (samples),Sample);
     currSample->id = hlr_strdup (textItem (it,0));
-    currSample->group = hlr_strdup (textItem (it,1));
-    currSample->groupIndex = -1;
-    textDestroy (it);    
-    if (arrayMax (groups) == 0)
-      textAdd (groups,currSample->group);
-    else {
-      for (i=0;i<arrayMax (groups);i++) {
-        if (strEqual (textItem (groups,i),currSample->group))
-          break;
-      }
-      if (i == arrayMax (groups))
-        textAdd (groups,currSample->group);
+    currSample->annotations = it;
+    currSample->colIndex = -1;
+    currSample->sameId = -1;
+    index = strhash_add (sampleIds,currSample->id,strlen (currSample->id));
+    if (index < arrayMax (samples) - 1) {
+      // duplicated sample name: chain the samples via the first one
+      for (k=index;arrp (samples,k,Sample)->sameId >= 0;k=arrp (samples,k,Sample)->sameId)
+        ;
+      arrp (samples,k,Sample)->sameId = arrayMax (samples) - 1;
     }
   }
-  ls_destroy (ls);
+  lr_destroy (ls);
 
-  /* determine group indices */
-  int groupSizes[arrayMax (groups)];
-  float avg[arrayMax (groups)];
-  //float libSizes[arrayMax (groups)];
-  for (j=0;j<arrayMax (groups);j++) {
-    groupSizes[j] = 0;
-    //libSizes[j] = 0.;
-    avg[j] = 0.;
+  /* factors and their group sizes */
+  createFactors (arg_present ("factors") ? arg_get ("factors") : "2");
+  assignGroups ();
+  if (arrayMax (factors) > 1 && !arg_present ("o"))
+    die ("-o PREFIX is required with more than one factor");
+  for (f=0;f<arrayMax (factors);f++) {
+    currFactor = arrp (factors,f,Factor);
+    int groupSizes[arrayMax (currFactor->groups)];
+    //float libSizes[arrayMax (groups)];
+    for (j=0;j<arrayMax (currFactor->groups);j++)
+      groupSizes[j] = 0;
+    for (i=0;i<arrayMax (samples);i++)
+      groupSizes[currFactor->sampleGroup[i]]++;
+    if (arrayMax (factors) > 1)
+      romsg ("Factor:\t%s",currFactor->name);
+    for (j=0;j<arrayMax (currFactor->groups);j++) {
+      romsg ("Group:\t%d\t%s\tSize:\t%d",j+1,textItem (currFactor->groups,j),groupSizes[j]);
+    }
     for (i=0;i<arrayMax (samples);i++) {
       currSample = arrp (samples,i,Sample);
-      if (strEqual (currSample->group,textItem (groups,j))) {
-        currSample->groupIndex = j;
-        groupSizes[j]++;
-      }
-     }
-  }
-  for (j=0;j<arrayMax (groups);j++) {
-    romsg ("Group:\t%d\t%s\tSize:\t%d",j+1,textItem (groups,j),groupSizes[j]);
-  }
-  for (i=0;i<arrayMax (samples);i++) {
-    currSample = arrp (samples,i,Sample);
-    romsg ("Sample:\t%d\t%s\t%s\t%d",i+1,currSample->id,currSample->group,currSample->groupIndex);
+      romsg ("Sample:\t%d\t%s\t%s\t%d",i+1,currSample->id,
+             textItem (currFactor->groups,currFactor->sampleGroup[i]),
+             currFactor->sampleGroup[i]);
+    }
+    if (arg_present ("o")) {
+      stringPrintf (str,"%s.%s.txt",arg_get ("o"),currFactor->name);
+      currFactor->fp = hlr_fopenWrite (string (str));
+      setvbuf (currFactor->fp,NULL,_IOFBF,OUTPUT_BUFFER_SIZE);
+    }
   }
 
 
   /* parse input data file */
+  setvbuf (stdout,outputBuffer,_IOFBF,OUTPUT_BUFFER_SIZE);
+  Block blocks[threads];
+  for (i=0;i<threads;i++) {
+    currBlock = &blocks[i];
+    currBlock->size = 65536;
+    currBlock->buffer = hlr_malloc (currBlock->size);
+    currBlock->len = 0;
+    currBlock->lines = arrayCreate (BLOCK_LINES,size_t);
+    currBlock->outs = hlr_malloc (arrayMax (factors) * sizeof (Stringa));
+    for (f=0;f<arrayMax (factors);f++)
+      currBlock->outs[f] = stringCreate (10000);
+    currBlock->values = hlr_calloc (arrayMax (samples) + 1,sizeof (double));
+    currBlock->grouped = hlr_calloc (arrayMax (samples) + 1,sizeof (double));
+    currBlock->sorted = hlr_calloc (arrayMax (samples) + 1,sizeof (double));
+  }
   if (arg_present ("gzip")) {
     stringPrintf (str, "gunzip -c %s", arg_get ("i"));
-    ls = ls_createFromPipe (string (str));
-  } else 
-    ls = ls_createFromFile (arg_get ("i"));
-  while (line = ls_nextLine (ls)) {
+    ls = lr_createFromPipe (string (str));
+  } else
+    ls = lr_createFromFile (arg_get ("i"));
+  while (line = lr_nextLine (ls)) {
     /* header line */
     if (line[0] == '#' || (line[0] == 'I' && line[1] == 'D')) {
+      // data lines read so far use the previous header
+      if (numBlocks > 0)
+        processBlocks (blocks,numBlocks);
+      numBlocks = 0;
       it = textStrtokP (line,"\t");
 
       if (arrayMax (it) <= skipCols)
         die ("Number of columns to skip is larger then input column number");
       for (i=0;i<arrayMax (it);i++) {
-        for (j=0;j<arrayMax (samples);j++) {
-          currSample = arrp (samples,j,Sample);
-          if (strEqual (currSample->id,textItem (it,i))) 
-	    currSample->colIndex = i;
-        }
-	if (i > skipCols)
-	  continue;
-        if (i > 0)
-          printf ("\t");
-        printf ("%s",textItem (it,i));
+        index = strhash_find (sampleIds,textItem (it,i),strlen (textItem (it,i)));
+        for (;index>=0;index=arrp (samples,index,Sample)->sameId)
+          arrp (samples,index,Sample)->colIndex = i;
+      }
+      for (f=0;f<arrayMax (factors);f++) {
+        currFactor = arrp (factors,f,Factor);
+        for (i=0;i<arrayMax (it) && i<=skipCols;i++)
+          fprintf (currFactor->fp,"%s%s",i > 0 ? "\t" : "",textItem (it,i));
+        for (k=0;k<numStats;k++)
+          for (j=0;j<arrayMax (currFactor->groups);j++)
+            if (numStats == 1 && stats[0] == STAT_MEAN)
+              fprintf (currFactor->fp,"\t%s",textItem (currFactor->groups,j));
+            else
+              fprintf (currFactor->fp,"\t%s_%s",textItem (currFactor->groups,j),
+                       statNames[stats[k]]);
+        fprintf (currFactor->fp,"\n");
       }
       textDestroy (it);
-      for (j=0;j<arrayMax (groups);j++) 
-	printf ("\t%s",textItem (groups,j));
-      printf ("\n");
-      fflush (stdout);
+      for (i=0;i<arrayMax (samples);i++) {
+        currSample = arrp (samples,i,Sample);
+        if (currSample->colIndex < 0)
+          warn ("Sample %s not found in the header of %s",currSample->id,arg_get ("i"));
+      }
+      findUsedColumns ();
+      for (f=0;f<arrayMax (factors);f++)
+        buildSlots (arrp (factors,f,Factor));
+      haveHeader = 1;
       continue;
     }
+    if (!haveHeader)
+      die ("no header line before line %s",line);
 
-    /* parse data lines */
-    it = textFieldtokP (line,"\t");
-    for (i=0;i<arrayMax (groups);i++)
-      avg[i] = 0.;
-    for (i=0;i<arrayMax (samples);i++) {
-      currSample = arrp (samples,i,Sample);
-      if (currSample->colIndex >= arrayMax (it))
-        die ("array size problem line=%s\nindex=%s\nmax=%d\n",line,currSample->colIndex,arrayMax (it));
-      avg[currSample->groupIndex] += atof (textItem (it,currSample->colIndex));
+    /* collect data lines into blocks, parse once and aggregate per factor */
+    if (numBlocks == 0 || arrayMax (blocks[numBlocks-1].lines) == BLOCK_LINES) {
+      if (numBlocks == threads) {
+        processBlocks (blocks,numBlocks);
+        numBlocks = 0;
+      }
+      numBlocks++;
     }
-    for (i=0;i<arrayMax (groups);i++)
-      avg[i] = avg[i] / groupSizes[i];
-
-    /* output data: averages */
-    printf ("%s",textItem (it,0));
-    for (i=1;i<skipCols+1;i++) // i < 6
-      printf ("\t%s",textItem (it,i));
-    for (i=0;i<arrayMax (groups);i++)
-      printf ("\t%.6f",avg[i]);
-    printf ("\n");
-    fflush (stdout);
-    textDestroy (it);
-  }
-  ls_destroy (ls);
+    currBlock = &blocks[numBlocks-1];
+    len = strlen (line) + 1;
+    if (currBlock->len + len > currBlock->size) {
+      currBlock->size = 2 * (currBlock->len + len);
+      if ((currBlock->buffer = realloc (currBlock->buffer,currBlock->size)) == NULL)
+        die ("out of memory");
+    }
+    memcpy (currBlock->buffer + currBlock->len,line,len);
+    array (currBlock->lines,arrayMax (currBlock->lines),size_t) = currBlock->len;
+    currBlock->len += len;
+  }
+  lr_destroy (ls);
+  if (numBlocks > 0)
+    processBlocks (blocks,numBlocks);
+  for (f=0;f<arrayMax (factors);f++) {
+    currFactor = arrp (factors,f,Factor);
+    if (currFactor->fp == stdout ? fflush (stdout) != 0 : fclose (currFactor->fp) != 0)
+      die ("error writing output");
+  }
 
   return 0;
 }
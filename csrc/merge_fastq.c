@@ -1,23 +1,65 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <zlib.h>
 #include "format.h"
 #include "log.h"
-#include "linestream.h"
+#include "linereader.h"
 #include "arg.h"
 #include "rofutil.h"
+#include "bgzf.h"
 
 #define AUTHOR_MAIL "roland.schmucki@roche.com"
 #define BSUB_PATH "bsub"
 #define SCRIPT_PREFIX "./merge_fastq"
+#define THREADS 4
+#define COPY_BUFFER_SIZE 4194304
 
 typedef struct {
   char *in;
   char *out;
+  int order;
 } Item;
 
+/* integrity statistics of one input file (-validate) */
+typedef struct {
+  long long bytes;   /* compressed bytes */
+  long long members; /* complete gzip members */
+  long long ubytes;  /* uncompressed bytes */
+  long long lines;
+  char *error;       /* NULL if the input is valid */
+} Check;
+
+/* one output file of the local merge engine */
+typedef struct {
+  char *out;
+  Texta ins;
+  int status;        /* 0 or errno of the first failure */
+  char *failed;      /* file that caused the failure */
+  long long bytes;   /* bytes written to out */
+  Array checks;      /* of Check, one per input with -validate */
+  long long reads;   /* FASTQ records written with -validate */
+  int invalid;       /* number of inputs that failed validation */
+} Merge;
+
+static Array merges; // of Merge
+static int nextMerge = 0;
+static int validate = 0;
+static int bgzfThreads = 0;  /* > 0: recompress the outputs to BGZF */
+static pthread_mutex_t mergeMutex = PTHREAD_MUTEX_INITIALIZER;
+
 static int orderItemsByOut (Item *a,Item *b)
 {
-  return strcmp (a->out,b->out);
+  int r = strcmp (a->out,b->out);
+  if (r != 0)
+    return r;
+  return a->order - b->order; // keep the input order within one output
 }
 
 
@@ -29,6 +71,9 @@ void usagef (int level)
 	 "IMPORTANT: input files for mate R1 and R2 reads must be in the same ORDER. \n"
 	 "\n"
          "Usage: %s [-sbatch] [-t INT] [-old-version] [-script-prefix STR] [-bsub-path STR] -i FILE \n"
+         "       %s -array [-max-jobs INT] [-submit-local] [-sbatch] [-t INT] [-old-version] \n"
+         "          [-script-prefix STR] [-bsub-path STR] -i FILE \n"
+         "       %s -local [-threads INT] [-validate] [-bgzf] -i FILE \n"
 	 "\n"
          "Mandatory parameters: \n"
 	 "\n"
@@ -43,21 +88,516 @@ void usagef (int level)
          "  -old-version    use old version which is much slower \n"
          "  -script-prefix  prefix for temp scripts, e.g. path, default %s \n"
 	 "  -bsub-path      path to bsub command on the shpc, default %s \n"
+         "  -array          write one job-array script <script-prefix>_array.sh and a manifest \n"
+         "                  <script-prefix>_array.manifest (one line per output file) and \n"
+         "                  submit all merges at once as a single job array \n"
+         "  -max-jobs INT   with -array, maximum number of array tasks running at the same time \n"
+         "                  (%%N of the job array), default unlimited \n"
+         "  -submit-local   with -array, run the array tasks on this host through xargs \n"
+         "                  instead of submitting them, e.g. for testing \n"
+         "  -local          merge inside this process instead of submitting jobs; \n"
+         "                  the gzipped inputs are concatenated with copy_file_range/sendfile \n"
+         "                  where the file system allows, exit code and bytes written are \n"
+         "                  reported per output file \n"
+         "  -threads  INT   with -local, number of output files merged in parallel, default %d \n"
+         "  -validate       with -local, inflate the inputs while they are copied (no extra I/O) \n"
+         "                  and check that each is a complete gzip stream (CRC32/ISIZE \n"
+         "                  trailers) with complete FASTQ records; the results are written \n"
+         "                  to <output>.stats, and outputs with _R1 in the name are compared \n"
+         "                  to their _R2 mate for equal read counts \n"
+         "  -bgzf           with -local, inflate the inputs and recompress them to BGZF \n"
+         "                  (blocked gzip, seekable and splittable, e.g. for bgzip/tabix/htslib) \n"
+         "                  instead of concatenating the gzip members; the outputs are merged \n"
+         "                  one after the other, each compressed in parallel on -threads threads \n"
          "\n"
 	 "\n"
          "Report bugs and feedback to %s \n",
-         arg_getProgName (), SCRIPT_PREFIX, BSUB_PATH, AUTHOR_MAIL);
+         arg_getProgName (), arg_getProgName (), arg_getProgName (), SCRIPT_PREFIX, BSUB_PATH, THREADS, AUTHOR_MAIL);
+}
+
+
+/*
+  Append the content of file descriptor in to out; try copy_file_range
+  first (no copy through user space, reflinks on some file systems),
+  then sendfile and finally plain read/write.
+  buf is a scratch buffer of COPY_BUFFER_SIZE bytes for the fallback.
+  Returns the number of bytes copied or -1 with errno set
+*/
+static long long appendFile (int in,int out,long long size,char *buf)
+{
+  long long done = 0;
+  ssize_t n,w;
+  int useCopyRange = 1;
+  int useSendfile = 1;
+
+  while (done < size) {
+    if (useCopyRange) {
+      n = copy_file_range (in,NULL,out,NULL,size-done,0);
+      if (n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+                    errno == EOPNOTSUPP || errno == EBADF)) {
+        useCopyRange = 0;
+        continue;
+      }
+    }
+    else if (useSendfile) {
+      n = sendfile (out,in,NULL,size-done);
+      if (n < 0 && (errno == ENOSYS || errno == EINVAL)) {
+        useSendfile = 0;
+        continue;
+      }
+    }
+    else {
+      n = read (in,buf,COPY_BUFFER_SIZE);
+      for (w=0;n > 0 && w < n;) {
+        ssize_t k = write (out,buf+w,n-w);
+        if (k < 0)
+          return -1;
+        w += k;
+      }
+    }
+    if (n < 0)
+      return -1;
+    if (n == 0) // file shrank while copying
+      break;
+    done += n;
+  }
+  return done;
+}
+
+
+static void countLines (unsigned char *p,int n,Check *c)
+{
+  unsigned char *end = p + n;
+
+  while ((p = memchr (p,'\n',end-p)) != NULL) {
+    c->lines++;
+    p++;
+  }
+}
+
+
+/*
+  Like appendFile, but reads through buf so that the data can be inflated
+  on the fly into ubuf (COPY_BUFFER_SIZE bytes) to validate the gzip
+  members and count lines. The gzip data is copied to out (if out >= 0) 
+  and the inflated data is recompressed to w (if w != NULL).
+  Returns the number of bytes read or -1 with errno set
+*/
+static long long inflateFile (int in,int out,BgzfWriter w,char *buf,
+                              unsigned char *ubuf,Check *c)
+{
+  z_stream zs;
+  ssize_t n,o,k;
+  int r,produced;
+  int inMember = 0;
+  int lastChar = '\n';
+
+  memset (&zs,0,sizeof (zs));
+  if (inflateInit2 (&zs,15+16) != Z_OK) // gzip format, checks CRC32 and ISIZE
+    die ("inflateInit2 failed");
+  while ((n = read (in,buf,COPY_BUFFER_SIZE)) > 0) {
+    for (k=0,o=0;out >= 0 && o < n;o += k) {
+      if ((k = write (out,buf+o,n-o)) < 0) {
+        inflateEnd (&zs);
+        return -1;
+      }
+    }
+    c->bytes += n;
+    zs.next_in = (unsigned char *)buf;
+    zs.avail_in = n;
+    while (zs.avail_in > 0 && c->error == NULL) {
+      zs.next_out = ubuf;
+      zs.avail_out = COPY_BUFFER_SIZE;
+      r = inflate (&zs,Z_NO_FLUSH);
+      produced = COPY_BUFFER_SIZE - zs.avail_out;
+      if (produced > 0) {
+        countLines (ubuf,produced,c);
+        lastChar = ubuf[produced-1];
+        c->ubytes += produced;
+        if (w != NULL && bgzf_write (w,ubuf,produced) != 0) {
+          inflateEnd (&zs);
+          return -1;
+        }
+      }
+      inMember = 1;
+      if (r == Z_STREAM_END) {
+        c->members++;
+        inMember = 0;
+        inflateReset (&zs);
+      }
+      else if (r == Z_BUF_ERROR && produced == 0)
+        break;
+      else if (r != Z_OK && r != Z_BUF_ERROR)
+        c->error = hlr_strdup (zs.msg != NULL ? zs.msg : "invalid gzip data");
+    }
+  }
+  inflateEnd (&zs);
+  if (n < 0)
+    return -1;
+  if (c->error == NULL && inMember)
+    c->error = hlr_strdup ("truncated gzip member (missing CRC32/ISIZE trailer)");
+  if (c->error == NULL && c->members == 0)
+    c->error = hlr_strdup ("no gzip member");
+  if (lastChar != '\n')
+    c->lines++;
+  if (c->error == NULL && c->lines % 4 != 0)
+    c->error = hlr_strdup ("number of lines is not a multiple of 4 (incomplete FASTQ record)");
+  return c->bytes;
+}
+
+
+static void writeStats (Merge *m)
+{
+  Stringa str = stringCreate (100);
+  Check *currCheck;
+  FILE *fP;
+  int i;
+  long long members = 0,ubytes = 0;
+
+  stringPrintf (str,"%s.stats",m->out);
+  fP = hlr_fopenWrite (string (str));
+  fprintf (fP,"#INPUT\tGZIP_MEMBERS\tBYTES\tUNCOMPRESSED_BYTES\tREADS\tSTATUS\n");
+  for (i=0;i<arrayMax (m->checks);i++) {
+    currCheck = arrp (m->checks,i,Check);
+    fprintf (fP,"%s\t%lld\t%lld\t%lld\t%lld\t%s\n",textItem (m->ins,i),
+             currCheck->members,currCheck->bytes,currCheck->ubytes,currCheck->lines/4,
+             currCheck->error != NULL ? currCheck->error : "OK");
+    members += currCheck->members;
+    ubytes += currCheck->ubytes;
+  }
+  fprintf (fP,"#TOTAL\t%lld\t%lld\t%lld\t%lld\t%s\n",members,m->bytes,ubytes,m->reads,
+           m->status != 0 ? strerror (m->status) : (m->invalid > 0 ? "INVALID" : "OK"));
+  fclose (fP);
+  stringDestroy (str);
 }
 
 
+static void runMerge (Merge *m,char *buf,unsigned char *ubuf)
+{
+  struct stat st;
+  int in,out,i;
+  long long n;
+  Check *currCheck = NULL;
+  BgzfWriter w = NULL;
+
+  out = open (m->out,O_WRONLY|O_CREAT|O_TRUNC,0666);
+  if (out < 0) {
+    m->status = errno;
+    m->failed = m->out;
+    return;
+  }
+  if (bgzfThreads > 0)
+    w = bgzf_openWrite (out,bgzfThreads,Z_DEFAULT_COMPRESSION);
+  for (i=0;i<arrayMax (m->ins);i++) {
+    in = open (textItem (m->ins,i),O_RDONLY);
+    if (validate || w != NULL) {
+      currCheck = arrayp (m->checks,i,Check);
+      memset (currCheck,0,sizeof (Check));
+    }
+    if (in < 0 || fstat (in,&st) != 0 ||
+        (n = (validate || w != NULL) ? inflateFile (in,w != NULL ? -1 : out,w,buf,ubuf,currCheck) :
+         appendFile (in,out,st.st_size,buf)) < 0) {
+      m->status = errno;
+      m->failed = textItem (m->ins,i);
+      if (in >= 0)
+        close (in);
+      break;
+    }
+    if (w == NULL)
+      m->bytes += n;
+    if (validate || w != NULL) {
+      m->reads += currCheck->lines / 4;
+      if (currCheck->error != NULL)
+        m->invalid++;
+    }
+    close (in);
+  }
+  if (w != NULL) {
+    if ((n = bgzf_closeWrite (w)) < 0) {
+      if (m->status == 0) {
+        m->status = errno;
+        m->failed = m->out;
+      }
+    }
+    else
+      m->bytes = n;
+  }
+  if (close (out) != 0 && m->status == 0) {
+    m->status = errno;
+    m->failed = m->out;
+  }
+  if (validate)
+    writeStats (m);
+}
+
+
+static void *mergeWorker (void *arg)
+{
+  char *buf = (char *)hlr_malloc (COPY_BUFFER_SIZE);
+  unsigned char *ubuf = (validate || bgzfThreads > 0) ? 
+    (unsigned char *)hlr_malloc (COPY_BUFFER_SIZE) : NULL;
+  int i;
+
+  for (;;) {
+    pthread_mutex_lock (&mergeMutex);
+    i = nextMerge++;
+    pthread_mutex_unlock (&mergeMutex);
+    if (i >= arrayMax (merges))
+      break;
+    runMerge (arrp (merges,i,Merge),buf,ubuf);
+  }
+  hlr_free (buf);
+  if (ubuf != NULL)
+    hlr_free (ubuf);
+  return NULL;
+}
+
+
+static int orderMergesByOut (Merge *a,Merge *b)
+{
+  return strcmp (a->out,b->out);
+}
+
+
+/*
+  Compare the read counts of the _R1 outputs with their _R2 mates,
+  append the result to both stats files. Returns the number of mismatches
+*/
+static int comparePairs (void)
+{
+  Stringa str = stringCreate (100);
+  Merge *currMerge;
+  Merge oneMerge;
+  Merge *mate;
+  char *pos;
+  FILE *fP;
+  int i,k,index;
+  int nfail = 0;
+
+  for (i=0;i<arrayMax (merges);i++) {
+    currMerge = arrp (merges,i,Merge);
+    pos = strstr (hlr_tail (currMerge->out),"_R1");
+    if (pos == NULL)
+      continue;
+    while (strstr (pos+1,"_R1") != NULL) // use the last _R1
+      pos = strstr (pos+1,"_R1");
+    stringPrintf (str,"%s",currMerge->out);
+    string (str)[pos - currMerge->out + 2] = '2';
+    oneMerge.out = string (str);
+    if (!arrayFind (merges,&oneMerge,&index,(ARRAYORDERF)orderMergesByOut))
+      continue;
+    mate = arrp (merges,index,Merge);
+    if (currMerge->reads != mate->reads) {
+      warn ("read counts differ: %s %lld, %s %lld",currMerge->out,currMerge->reads,
+            mate->out,mate->reads);
+      nfail++;
+    }
+    printf ("#PAIR\t%s\t%s\t%lld\t%lld\t%s\n",currMerge->out,mate->out,
+            currMerge->reads,mate->reads,currMerge->reads == mate->reads ? "OK" : "MISMATCH");
+    for (k=0;k<2;k++) {
+      stringPrintf (str,"%s.stats",k == 0 ? currMerge->out : mate->out);
+      fP = hlr_fopenAppend (string (str));
+      fprintf (fP,"#PAIR\t%s\t%s\t%lld\t%lld\t%s\n",currMerge->out,mate->out,
+               currMerge->reads,mate->reads,currMerge->reads == mate->reads ? "OK" : "MISMATCH");
+      fclose (fP);
+    }
+  }
+  stringDestroy (str);
+  return nfail;
+}
+
+
+/*
+  Merge all outputs inside this process with a bounded number of threads;
+  items must be sorted by output. With doBgzf, the outputs are merged one
+  after the other, each recompressed to BGZF on all threads.
+  Returns the number of failed outputs
+*/
+static int mergeLocal (Array items,int threads,int doValidate,int doBgzf)
+{
+  Item *currItem;
+  Merge *currMerge = NULL;
+  pthread_t tids[threads];
+  int i,nfail = 0;
+  long long total = 0;
+
+  merges = arrayCreate (100,Merge);
+  for (i=0;i<arrayMax (items);i++) {
+    currItem = arrp (items,i,Item);
+    if (currMerge == NULL || !strEqual (currMerge->out,currItem->out)) {
+      currMerge = arrayp (merges,arrayMax (merges),Merge);
+      currMerge->out = currItem->out;
+      currMerge->ins = textCreate (10);
+      currMerge->status = 0;
+      currMerge->failed = NULL;
+      currMerge->bytes = 0;
+      currMerge->checks = arrayCreate (10,Check);
+      currMerge->reads = 0;
+      currMerge->invalid = 0;
+    }
+    textAdd (currMerge->ins,currItem->in);
+    printf ("append %s to %s\n",currItem->in,currItem->out);
+  }
+  validate = doValidate;
+  if (doBgzf) {
+    bgzfThreads = threads;
+    threads = 1;
+  }
+  if (threads > arrayMax (merges))
+    threads = arrayMax (merges);
+
+  umask (2);
+  for (i=0;i<threads;i++)
+    if (pthread_create (&tids[i],NULL,mergeWorker,NULL) != 0)
+      die ("cannot create thread");
+  for (i=0;i<threads;i++)
+    pthread_join (tids[i],NULL);
+
+  printf ("#EXIT\tBYTES\tOUTFILE\n");
+  for (i=0;i<arrayMax (merges);i++) {
+    currMerge = arrp (merges,i,Merge);
+    printf ("%d\t%lld\t%s\n",currMerge->status,currMerge->bytes,currMerge->out);
+    if (currMerge->status != 0) {
+      warn ("merging into %s failed: %s: %s",currMerge->out,currMerge->failed,
+            strerror (currMerge->status));
+      nfail++;
+    }
+    else if (currMerge->invalid > 0) {
+      if (validate)
+        warn ("%d input files of %s failed validation, see %s.stats",
+              currMerge->invalid,currMerge->out,currMerge->out);
+      else
+        warn ("%d input files of %s are not valid gzip/FASTQ files, "
+              "rerun with -validate for details",currMerge->invalid,currMerge->out);
+      nfail++;
+    }
+    total += currMerge->bytes;
+  }
+  if (validate)
+    nfail += comparePairs ();
+  romsg ("%d of %d output files merged without errors, %lld bytes written",
+         arrayMax (merges)-nfail,arrayMax (merges),total);
+  return nfail;
+}
+
+/*
+  Absolute path of the directory of output file out
+*/
+static char *outputDir (char *out)
+{
+  Stringa str = stringCreate (100);
+  Texta it = textStrtokP (out, "/");
+  char *outdir;
+
+  if (arrayMax (it) == 1) 
+    outdir = realpath (".", NULL);
+  else {
+    stringPrintf (str, "%s", out);
+    stringChop (str, strlen (textItem (it, arrayMax (it)-1)));
+    outdir = realpath (string (str), NULL);
+  }
+  if (outdir == NULL)
+    die ("output directory of %s does not exist", out);
+  textDestroy (it);
+  stringDestroy (str);
+  return outdir;
+}
+
+
+/*
+  Write a single job-array script plus manifest for all outputs and
+  submit it with one call; items must be sorted by output
+*/
+static void submitArray (Array items,char *scriptPrefix,char *bsubPath,
+                         int timeMinutes,int maxJobs)
+{
+  Stringa str = stringCreate (100);
+  Stringa limit = stringCreate (10);
+  Item *currItem;
+  char *prevOut = NULL;
+  char *outdir;
+  char *in;
+  char *scriptName;
+  char *manifestName;
+  FILE *fP;
+  int i,n = 0;
+
+  stringPrintf (str,"%s_array.manifest",scriptPrefix);
+  manifestName = hlr_strdup (string (str));
+  stringPrintf (str,"%s_array.sh",scriptPrefix);
+  scriptName = hlr_strdup (string (str));
+
+  /* manifest: output file followed by its input files, tab-delimited */
+  fP = hlr_fopenWrite (manifestName);
+  for (i=0;i<arrayMax (items);i++) {
+    currItem = arrp (items,i,Item);
+    if (prevOut == NULL || !strEqual (prevOut,currItem->out)) {
+      if (prevOut != NULL)
+        fprintf (fP,"\n");
+      outdir = outputDir (currItem->out);
+      fprintf (fP,"%s/%s",outdir,hlr_tail (currItem->out));
+      printf ("OUTDIR=%s\tOUTFILE=%s\n",outdir,hlr_tail (currItem->out));
+      free (outdir);
+      prevOut = currItem->out;
+      n++;
+    }
+    if ((in = realpath (currItem->in,NULL)) == NULL)
+      die ("input file %s does not exist",currItem->in);
+    fprintf (fP,"\t%s",in);
+    printf ("append %s to %s\n",currItem->in,currItem->out);
+    free (in);
+  }
+  fprintf (fP,"\n");
+  fclose (fP);
+  if ((in = realpath (manifestName,NULL)) == NULL)
+    die ("cannot resolve %s",manifestName);
+  strReplace (&manifestName,in);
+  free (in);
+
+  /* the task index comes from LSF, Slurm or the first argument (-submit-local) */
+  fP = hlr_fopenWrite (scriptName);
+  fprintf (fP,"#!/bin/bash\n\numask 2\n\n"
+           "i=${LSB_JOBINDEX:-${SLURM_ARRAY_TASK_ID:-$1}}\n"
+           "IFS=$'\\t' read -r -a f <<< \"$(sed -n \"${i}p\" %s)\"\n"
+           "out=\"${f[0]}\"\n",manifestName);
+  if (arg_present ("old-version"))
+    fprintf (fP,"for i in \"${f[@]:1}\"; do\n  gunzip -c \"$i\" | gzip -c >> \"$out\"\ndone\n");
+  else
+    fprintf (fP,"cat \"${f[@]:1}\" > \"$out\"\n");
+  fclose (fP);
+
+  if (maxJobs > 0)
+    stringPrintf (limit,"%%%d",maxJobs);
+  else
+    stringClear (limit);
+  if (arg_present ("submit-local"))
+    stringPrintf (str,"seq 1 %d | xargs -P %d -I{} bash %s {}",
+                  n,maxJobs > 0 ? maxJobs : n,scriptName);
+  else if (arg_present ("sbatch"))
+    stringPrintf (str,"chmod +x %s && sbatch --time=%d --array=1-%d%s -J merge_fastq "
+                  "-e merge_fastq_%%a.err -o merge_fastq_%%a.out %s",
+                  scriptName,timeMinutes,n,string (limit),scriptName);
+  else
+    stringPrintf (str,"%s -q preempt -J \"merge_fastq[1-%d]%s\" -e merge_fastq_%%I.err "
+                  "-o merge_fastq_%%I.out source %s",
+                  bsubPath,n,string (limit),scriptName);
+  printf ("#%d output files in one job array\n",n);
+  hlr_system (string (str),1);
+  hlr_free (scriptName);
+  hlr_free (manifestName);
+  stringDestroy (limit);
+  stringDestroy (str);
+}
+
 
 int main (int argc,char *argv[])
 {
 
-  if (arg_init (argc,argv,"bsub-path,1 script-prefix,1 sbatch,0 old-version,0 t,1","i",usagef) != argc)
+  if (arg_init (argc,argv,"bsub-path,1 script-prefix,1 sbatch,0 old-version,0 t,1 local,0 threads,1 "
+                "array,0 max-jobs,1 submit-local,0 validate,0 bgzf,0","i",usagef) != argc)
     die ("wrong number of arguments; invoke program without params for help");
   
-  LineStream ls;
+  LineReader ls;
   char *line;
   Texta it;
   Array items = arrayCreate (10,Item);
@@ -74,6 +614,8 @@ int main (int argc,char *argv[])
   char *outdir = NULL;
   char *outfile = NULL;
   char *bsubPath = NULL;
+  int threads = THREADS;
+  int maxJobs = 0;
 	
   if (arg_present ("t"))
     timeMinutes = atoi (arg_get ("t"));
@@ -87,9 +629,25 @@ int main (int argc,char *argv[])
     strReplace (&bsubPath, arg_get ("bsub-path"));
   else
     strReplace (&bsubPath, BSUB_PATH); 
+
+  if (arg_present ("threads")) {
+    threads = atoi (arg_get ("threads"));
+    if (threads < 1)
+      die ("-threads must be at least 1");
+  }
+  if (arg_present ("local") && arg_present ("old-version"))
+    die ("-old-version cannot be combined with -local");
+  if (arg_present ("local") && arg_present ("array"))
+    die ("-array cannot be combined with -local");
+  if (arg_present ("max-jobs"))
+    maxJobs = atoi (arg_get ("max-jobs"));
+  if ((arg_present ("max-jobs") || arg_present ("submit-local")) && !arg_present ("array"))
+    die ("-max-jobs and -submit-local require -array");
+  if ((arg_present ("validate") || arg_present ("bgzf")) && !arg_present ("local"))
+    die ("-validate and -bgzf require -local");
 	
-  ls = ls_createFromFile (arg_get ("i"));
-  while (line = ls_nextLine (ls)) {
+  ls = lr_createFromFile (arg_get ("i"));
+  while (line = lr_nextLine (ls)) {
     if (line[0] == '#')
       continue;
     it = textStrtokP (line,"\t");
@@ -98,12 +656,22 @@ int main (int argc,char *argv[])
     currItem = arrayp (items,arrayMax (items),Item);
     currItem->in = hlr_strdup (textItem (it,0));
     currItem->out = hlr_strdup (textItem (it,1));
+    currItem->order = arrayMax (items);
     textDestroy (it);
   }
-  ls_destroy (ls);
+  lr_destroy (ls);
+  if (arrayMax (items) == 0)
+    die ("no input files in %s",arg_get ("i"));
 
   arraySort (items,(ARRAYORDERF)orderItemsByOut);
 
+  if (arg_present ("local"))
+    return mergeLocal (items,threads,arg_present ("validate"),arg_present ("bgzf")) > 0 ? 1 : 0;
+  if (arg_present ("array")) {
+    submitArray (items,scriptPrefix,bsubPath,timeMinutes,maxJobs);
+    return 0;
+  }
+
   prevItem = arrp (items,0,Item);
   textAdd (outs,prevItem->out);
   for (i=1;i<arrayMax (items);i++) {
@@ -119,16 +687,9 @@ int main (int argc,char *argv[])
     strReplace (&scriptName,  string(str));
 
     // get directory of output file names
-    Texta it = textStrtokP (textItem (outs,i), "/");
-    strReplace (&outfile, textItem (it, arrayMax (it)-1));
-    if (arrayMax (it) == 1) 
-      strReplace (&outdir, realpath (".", NULL));
-    else {
-      stringPrintf (str, textItem (outs,i));
-      stringChop (str, strlen (textItem (it, arrayMax (it)-1)));
-      strReplace (&outdir, realpath (string (str), NULL));
-    }
-    textDestroy (it);
+    strReplace (&outfile, hlr_tail (textItem (outs,i)));
+    hlr_free (outdir);
+    outdir = outputDir (textItem (outs,i));
     printf ("OUTDIR=%s\tOUTFILE=%s\n", outdir, outfile);
 
     fP =  hlr_fopenWrite (scriptName);
@@ -0,0 +1,355 @@
+#include "format.h"
+#include "log.h"
+#include "linereader.h"
+#include "arg.h"
+#include "strhash.h"
+#include "gct.h"
+
+#define AUTHOR_MAIL "roland.schmucki@roche.com"
+#define OUTPUT_BUFFER_SIZE 1048576
+
+
+/* values of one row of an input file, kept in memory */
+typedef struct {
+  long start;    /* offset + 1 into Input.values, 0 if the row is missing */
+  int len;
+} Cell;
+
+typedef struct {
+  char *fileName;
+  Texta samples;
+  Stringa fill;       /* "\tFILL" once per sample */
+  /* in-memory merge */
+  Array values;       /* of char, values of all rows, concatenated */
+  Array cells;        /* of Cell, by key id */
+  /* sorted merge */
+  LineReader ls;
+  Stringa rows[2];    /* current and next row */
+  int cur;
+  char *key;          /* of the current row, NULL at end of file */
+  char *desc;
+  char *vals;
+  char *nextKey;
+  char *nextDesc;
+  char *nextVals;
+} Input;
+
+
+void usagef (int level)
+{
+  romsg ("Description: \n"
+         "\n"
+         "Merge several input GCT files into one output GCT file (sent to stdout). \n"
+         "The rows are the union of the row names of all files, sorted by name; \n"
+         "the description is taken from the last file with the row. \n"
+         "\n"
+         "Usage: %s [-fill STRING] [-sorted] FILE1 FILE2 [FILE3 ...] \n"
+         "\n"
+         "Optional parameters: \n"
+         "\n"
+         "\t-fill STRING  value of the samples of a file without the row (default: 0) \n"
+         "\t-sorted       the input files are sorted by row name (bytewise, e.g. LC_ALL=C sort); \n"
+         "\t              the files are merged line by line in bounded memory instead of \n"
+         "\t              being loaded \n"
+         "\n"
+         "Report bugs and feedback to %s \n",
+         arg_getProgName (),AUTHOR_MAIL);
+}
+
+
+
+static void createFill (Input *in,char *fill)
+{
+  int i;
+
+  in->fill = stringCreate (10);
+  for (i=0;i<arrayMax (in->samples);i++) {
+    stringCatChar (in->fill,'\t');
+    stringCat (in->fill,fill);
+  }
+}
+
+
+
+static void writeValues (FILE *fp,Input *in,char *values,int len)
+{
+  if (values == NULL) {
+    fwrite (string (in->fill),1,stringLen (in->fill),fp);
+    return;
+  }
+  if (arrayMax (in->samples) == 0)
+    return;
+  putc ('\t',fp);
+  fwrite (values,1,len,fp);
+}
+
+
+
+static int countSamples (Input *inputs,int numInputs)
+{
+  int i;
+  int numSamples = 0;
+
+  for (i=0;i<numInputs;i++)
+    numSamples += arrayMax (inputs[i].samples);
+  return numSamples;
+}
+
+
+
+/* column header line (line 3) of the merged GCT, without newline */
+static char *headerLine (Input *inputs,int numInputs)
+{
+  Stringa s = stringCreate (1000);
+  char *line;
+  int i,j;
+
+  stringCpy (s,"NAME\tDESCRIPTION");
+  for (i=0;i<numInputs;i++)
+    for (j=0;j<arrayMax (inputs[i].samples);j++)
+      stringAppendf (s,"\t%s",textItem (inputs[i].samples,j));
+  line = hlr_strdup (string (s));
+  stringDestroy (s);
+  return line;
+}
+
+
+
+static StrHash sortKeys = NULL;
+
+static int orderIdsByKey (int *a,int *b)
+{
+  return strcmp (strhash_key (sortKeys,*a),strhash_key (sortKeys,*b));
+}
+
+
+
+/*
+  In-memory merge: every file is read once; its values are appended to
+  the file's buffer and indexed by the id of the row name in keys
+*/
+static void mergeInMemory (Input *inputs,int numInputs,char *fill)
+{
+  StrHash keys = strhash_create (100000);
+  Array descs = arrayCreate (100000,char *);
+  Array order;
+  LineReader ls;
+  char *line,*desc,*values,*lineEnd;
+  Input *in;
+  Cell *cell;
+  char **currDesc;
+  int len,descLen;
+  int i,j,id;
+
+  for (i=0;i<numInputs;i++) {
+    in = inputs + i;
+    ls = lr_createFromFile (in->fileName);
+    in->samples = gct_readHeader (ls,NULL);
+    createFill (in,fill);
+    in->values = arrayCreate (1000000,char);
+    in->cells = arrayCreate (100000,Cell);
+    /* the rows are split in place, only the parts kept are copied */
+    while (line = lr_nextLineView (ls,&len)) {
+      lineEnd = line + len;
+      if ((desc = memchr (line,'\t',len)) == NULL)
+        die ("GCT row without description: %.*s",len,line);
+      id = strhash_add (keys,line,desc - line);
+      desc++;
+      if ((values = memchr (desc,'\t',lineEnd - desc)) != NULL)
+        descLen = values++ - desc;
+      else
+        descLen = (values = lineEnd) - desc;
+      currDesc = arrayp (descs,id,char *);
+      if (*currDesc == NULL || strncmp (*currDesc,desc,descLen) != 0 ||
+          (*currDesc)[descLen] != '\0') {
+        hlr_free (*currDesc);
+        *currDesc = hlr_malloc (descLen + 1);
+        memcpy (*currDesc,desc,descLen);
+        (*currDesc)[descLen] = '\0';
+      }
+      cell = arrayp (in->cells,id,Cell);
+      cell->start = arrayMax (in->values) + 1;
+      cell->len = lineEnd - values;
+      if (cell->len > 0) {
+        arrayp (in->values,cell->start + cell->len - 2,char);
+        memcpy (arrp (in->values,cell->start - 1,char),values,cell->len);
+      }
+    }
+    lr_destroy (ls);
+  }
+
+  order = arrayCreate (strhash_count (keys),int);
+  for (i=0;i<strhash_count (keys);i++)
+    array (order,i,int) = i;
+  sortKeys = keys;
+  arraySort (order,(ARRAYORDERF)orderIdsByKey);
+
+  printf ("#1.2\n%d\t%d\n%s\n",strhash_count (keys),countSamples (inputs,numInputs),
+          headerLine (inputs,numInputs));
+  for (j=0;j<arrayMax (order);j++) {
+    id = arru (order,j,int);
+    fputs (strhash_key (keys,id),stdout);
+    putchar ('\t');
+    fputs (arru (descs,id,char *),stdout);
+    for (i=0;i<numInputs;i++) {
+      in = inputs + i;
+      if (id < arrayMax (in->cells) && arrp (in->cells,id,Cell)->start > 0) {
+        cell = arrp (in->cells,id,Cell);
+        writeValues (stdout,in,arrp (in->values,cell->start - 1,char),cell->len);
+      }
+      else
+        writeValues (stdout,in,NULL,0);
+    }
+    putchar ('\n');
+  }
+}
+
+
+
+/* reads the next row of a sorted input into in->rows[1 - in->cur] */
+static void readNext (Input *in)
+{
+  char *line;
+  int len;
+  Stringa row = in->rows[1 - in->cur];
+
+  if ((line = lr_nextLineView (in->ls,&len)) == NULL) {
+    in->nextKey = NULL;
+    return;
+  }
+  stringNCpy (row,line,len);
+  in->nextKey = string (row);
+  gct_splitRow (in->nextKey,&in->nextDesc,&in->nextVals);
+}
+
+
+
+/*
+  Moves to the next row name of a sorted input; of several rows with the
+  same name the last one is kept
+*/
+static void advance (Input *in)
+{
+  do {
+    in->cur = 1 - in->cur;
+    in->key = in->nextKey;
+    in->desc = in->nextDesc;
+    in->vals = in->nextVals;
+    if (in->key == NULL)
+      return;
+    readNext (in);
+    if (in->nextKey != NULL && strcmp (in->nextKey,in->key) < 0)
+      die ("%s is not sorted by row name: %s after %s",in->fileName,in->nextKey,in->key);
+  } while (in->nextKey != NULL && strEqual (in->nextKey,in->key));
+}
+
+
+
+/* opens a sorted input; numRows is set to the row count in its header */
+static void openSorted (Input *in,int *numRows)
+{
+  in->ls = lr_createFromFile (in->fileName);
+  in->samples = gct_readHeader (in->ls,numRows);
+  in->rows[0] = stringCreate (10000);
+  in->rows[1] = stringCreate (10000);
+  in->cur = 0;
+  readNext (in);
+  advance (in);
+}
+
+
+
+/*
+  Sorted merge: k-way merge of the current rows of all files in a single
+  pass; the row count is set in the header by gct_outFinish
+*/
+static void mergeSorted (Input *inputs,int numInputs,char *fill)
+{
+  Input *in;
+  GctOut out;
+  FILE *fp;
+  char *minKey;
+  char *desc;
+  int *match = hlr_calloc (numInputs,sizeof (int));
+  int i;
+  int numRows = 0;
+  int inRows,maxRows = 0;
+
+  for (i=0;i<numInputs;i++) {
+    inRows = 0;
+    openSorted (inputs + i,&inRows);
+    createFill (inputs + i,fill);
+    if (inRows > maxRows)
+      maxRows = inRows;
+  }
+  // the union has at least as many rows as the largest input
+  out = gct_outCreate (stdout,maxRows,countSamples (inputs,numInputs),
+                       headerLine (inputs,numInputs));
+  fp = gct_outRows (out);
+  for (;;) {
+    minKey = NULL;
+    for (i=0;i<numInputs;i++)
+      if (inputs[i].key != NULL && (minKey == NULL || strcmp (inputs[i].key,minKey) < 0))
+        minKey = inputs[i].key;
+    if (minKey == NULL)
+      break;
+    numRows++;
+    desc = NULL;
+    for (i=0;i<numInputs;i++) {
+      match[i] = inputs[i].key != NULL && strEqual (inputs[i].key,minKey);
+      if (match[i])
+        desc = inputs[i].desc;
+    }
+    fputs (minKey,fp);
+    putc ('\t',fp);
+    fputs (desc,fp);
+    for (i=0;i<numInputs;i++) {
+      in = inputs + i;
+      if (match[i])
+        writeValues (fp,in,in->vals,strlen (in->vals));
+      else
+        writeValues (fp,in,NULL,0);
+    }
+    putc ('\n',fp);
+    for (i=0;i<numInputs;i++)
+      if (match[i])
+        advance (inputs + i);
+  }
+  hlr_free (match);
+  for (i=0;i<numInputs;i++) {
+    in = inputs + i;
+    lr_destroy (in->ls);
+    stringDestroy (in->rows[0]);
+    stringDestroy (in->rows[1]);
+  }
+  gct_outFinish (out,numRows);
+}
+
+
+
+int main (int argc,char *argv[])
+{
+  int first;
+  int numInputs;
+  Input *inputs;
+  char *fill;
+  int i;
+
+  first = arg_init (argc,argv,"fill,1 sorted,0","",usagef);
+  numInputs = argc - first;
+  if (numInputs < 2)
+    die ("at least 2 input files needed; invoke program without params for help");
+  fill = arg_present ("fill") ? arg_get ("fill") : "0";
+  setvbuf (stdout,NULL,_IOFBF,OUTPUT_BUFFER_SIZE);
+
+  inputs = hlr_calloc (numInputs,sizeof (Input));
+  for (i=0;i<numInputs;i++)
+    inputs[i].fileName = argv[first + i];
+
+  if (!arg_present ("sorted"))
+    mergeInMemory (inputs,numInputs,fill);
+  else
+    mergeSorted (inputs,numInputs,fill);
+  fflush (stdout);
+  return 0;
+}
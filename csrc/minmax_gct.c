@@ -0,0 +1,359 @@
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "format.h"
+#include "log.h"
+#include "linereader.h"
+#include "arg.h"
+#include "gct.h"
+
+#define AUTHOR_MAIL "roland.schmucki@roche.com"
+#define OUTPUT_BUFFER_SIZE 1048576
+
+enum {OP_GT,OP_GE,OP_LT,OP_LE};
+
+/* a row passes if at least need of its values v satisfy v OP threshold */
+typedef struct {
+  int op;
+  double threshold;
+  int need;      /* -1: all values */
+} Condition;
+
+/* MODE of the script: comparison per value and the default count */
+static struct {
+  char *name;
+  int op;
+  int need;
+} modes[] = {
+  {"MIN",OP_GT,-1},          /* row min > T */
+  {"MIN-EQUAL",OP_GE,-1},    /* row min >= T */
+  {"MIN-REVERSE",OP_LT,1},   /* row min < T */
+  {"MAX",OP_LT,-1},          /* row max < T */
+  {"MAX-EQUAL",OP_LE,-1},    /* row max <= T */
+  {"MAX-REVERSE",OP_GT,1},   /* row max > T */
+  {NULL,0,0}
+};
+
+
+void usagef (int level)
+{
+  romsg ("Description: \n"
+         "\n"
+         "Filter away all features from a GCT file if the row MIN or MAX is \n"
+         "lower/greater/lower equal (MIN-EQUAL)/greater equal (MAX-EQUAL) than \n"
+         "a user given threshold. Use MIN-/MAX-REVERSE to output reversed comparison. \n"
+         "Results are sent to the standard output. \n"
+         "\n"
+         "Usage: %s [-count K] [-and CONDITIONS] [-gctb FILE] GCT_FILE THRESHOLD MODE \n"
+         "\n"
+         "Mandatory parameters: \n"
+         "\n"
+         "\tGCT_FILE      input GCT file, text or binary (.gctb, see gct2gctb) \n"
+         "\tTHRESHOLD     threshold value (real number) \n"
+         "\tMODE          MIN or MAX or MIN-EQUAL or MAX-EQUAL or MIN-REVERSE or MAX-REVERSE \n"
+         "\t              MIN:         keep rows with all values >  THRESHOLD \n"
+         "\t              MIN-EQUAL:   keep rows with all values >= THRESHOLD \n"
+         "\t              MIN-REVERSE: keep rows with a value    <  THRESHOLD \n"
+         "\t              MAX:         keep rows with all values <  THRESHOLD \n"
+         "\t              MAX-EQUAL:   keep rows with all values <= THRESHOLD \n"
+         "\t              MAX-REVERSE: keep rows with a value    >  THRESHOLD \n"
+         "\n"
+         "Optional parameters: \n"
+         "\n"
+         "\t-count K      keep rows with at least K values passing the comparison of MODE, \n"
+         "\t              e.g. -count 3 GCT_FILE 10 MIN-EQUAL keeps rows with >= 10 in at least 3 samples \n"
+         "\t-and CONDITIONS  further conditions that must hold as well, comma-separated, \n"
+         "\t              each MODE:THRESHOLD or MODE:THRESHOLD:K \n"
+         "\t-gctb FILE    write the kept rows as binary GCT to FILE instead of the standard \n"
+         "\t              output; values are float32, or of the input type for .gctb input \n"
+         "\n"
+         "Values that are not numbers (e.g. NA) are ignored; rows without any number are removed. \n"
+         "\n"
+         "Report bugs and feedback to %s \n",
+         arg_getProgName (),AUTHOR_MAIL);
+}
+
+
+
+static void addCondition (Array conditions,char *mode,char *threshold,char *count)
+{
+  Condition *currCondition;
+  char *end;
+  int i;
+
+  for (i=0;modes[i].name != NULL;i++)
+    if (strEqual (modes[i].name,mode))
+      break;
+  if (modes[i].name == NULL)
+    die ("MODE %s is not allowed",mode);
+  currCondition = arrayp (conditions,arrayMax (conditions),Condition);
+  currCondition->op = modes[i].op;
+  currCondition->need = modes[i].need;
+  currCondition->threshold = strtod (threshold,&end);
+  if (end == threshold || *end != '\0')
+    die ("THRESHOLD %s is not a number",threshold);
+  if (count != NULL) {
+    currCondition->need = atoi (count);
+    if (currCondition->need < 1)
+      die ("count %s: must be at least 1",count);
+  }
+}
+
+
+
+/* Number of values satisfying v OP t; plain loops without early exit */
+static int countPassing (double *values,int n,int op,double t)
+{
+  int i;
+  int count = 0;
+
+  switch (op) {
+  case OP_GT:
+    for (i=0;i<n;i++)
+      count += values[i] > t;
+    break;
+  case OP_GE:
+    for (i=0;i<n;i++)
+      count += values[i] >= t;
+    break;
+  case OP_LT:
+    for (i=0;i<n;i++)
+      count += values[i] < t;
+    break;
+  case OP_LE:
+    for (i=0;i<n;i++)
+      count += values[i] <= t;
+    break;
+  }
+  return count;
+}
+
+
+
+/*
+  Minimum and maximum of values (n > 0, no NaN); two values per
+  instruction with SSE2, which every x86-64 has
+*/
+static void rowMinMax (double *values,int n,double *min,double *max)
+{
+  int i = 0;
+  double lo,hi;
+#ifdef __SSE2__
+  __m128d vlo,vhi,v;
+  double pair[2];
+
+  if (n >= 2) {
+    vlo = vhi = _mm_loadu_pd (values);
+    for (i=2;i+1<n;i+=2) {
+      v = _mm_loadu_pd (values + i);
+      vlo = _mm_min_pd (vlo,v);
+      vhi = _mm_max_pd (vhi,v);
+    }
+    _mm_storeu_pd (pair,vlo);
+    lo = pair[0] < pair[1] ? pair[0] : pair[1];
+    _mm_storeu_pd (pair,vhi);
+    hi = pair[0] > pair[1] ? pair[0] : pair[1];
+  }
+  else
+#endif
+  {
+    lo = hi = values[0];
+    i = 1;
+  }
+  for (;i<n;i++) {
+    if (values[i] < lo)
+      lo = values[i];
+    if (values[i] > hi)
+      hi = values[i];
+  }
+  *min = lo;
+  *max = hi;
+}
+
+
+
+/*
+  1 if the numbers values (n > 0) satisfy all conditions. Conditions on
+  all values or on any value are decided by the row minimum or maximum,
+  other counts by countPassing
+*/
+static int passes (Array conditions,double *values,int n)
+{
+  Condition *currCondition;
+  double min,max,t;
+  int haveMinMax = 0;
+  int i,ok;
+
+  for (i=0;i<arrayMax (conditions);i++) {
+    currCondition = arrp (conditions,i,Condition);
+    t = currCondition->threshold;
+    if (currCondition->need != -1 && currCondition->need != 1) {
+      if (countPassing (values,n,currCondition->op,t) < currCondition->need)
+        return 0;
+      continue;
+    }
+    if (!haveMinMax) {
+      rowMinMax (values,n,&min,&max);
+      haveMinMax = 1;
+    }
+    /* all values: the extreme closest to t decides; any value: the farthest */
+    switch (currCondition->op) {
+    case OP_GT:
+      ok = (currCondition->need < 0 ? min : max) > t;
+      break;
+    case OP_GE:
+      ok = (currCondition->need < 0 ? min : max) >= t;
+      break;
+    case OP_LT:
+      ok = (currCondition->need < 0 ? max : min) < t;
+      break;
+    default:
+      ok = (currCondition->need < 0 ? max : min) <= t;
+      break;
+    }
+    if (!ok)
+      return 0;
+  }
+  return 1;
+}
+
+
+
+int main (int argc,char *argv[])
+{
+  int first;
+  LineReader ls;
+  char *line,*desc;
+  char *s,*end,*lineEnd;
+  Stringa row = NULL;
+  Array conditions = arrayCreate (2,Condition);
+  Texta items,it;
+  GctOut out = NULL;
+  GctbWriter w = NULL;
+  Gctb in;
+  double *rowValues = NULL;
+  Array values;
+  double value;
+  int maxRows = 0;
+  int numCols = 0;
+  int numRows = 0;
+  int len;
+  long i,j;
+
+  first = arg_init (argc,argv,"count,1 and,1 gctb,1","",usagef);
+  if (argc - first != 3)
+    die ("3 input arguments required; invoke program without params for help");
+  addCondition (conditions,argv[first+2],argv[first+1],
+                arg_present ("count") ? arg_get ("count") : NULL);
+  if (arg_present ("and")) {
+    items = textFieldtokP (arg_get ("and"),",");
+    for (i=0;i<arrayMax (items);i++) {
+      it = textFieldtokP (textItem (items,i),":");
+      if (arrayMax (it) < 2 || arrayMax (it) > 3)
+        die ("condition %s: expected MODE:THRESHOLD or MODE:THRESHOLD:K",textItem (items,i));
+      addCondition (conditions,textItem (it,0),textItem (it,1),
+                    arrayMax (it) == 3 ? textItem (it,2) : NULL);
+      textDestroy (it);
+    }
+    textDestroy (items);
+  }
+  setvbuf (stdout,NULL,_IOFBF,OUTPUT_BUFFER_SIZE);
+
+  if (gctb_isGctb (argv[first])) {
+    /* rows of the mapped file; kept rows keep the value type of the input */
+    in = gctb_open (argv[first]);
+    numCols = gctb_numCols (in);
+    if (arg_present ("gctb"))
+      w = gct_gctbWriter (arg_get ("gctb"),gct_sampleNames (argv[first]),in->header->type);
+    else
+      out = gct_outCreate (stdout,gctb_numRows (in),numCols,
+                         gct_headerLine (gct_sampleNames (argv[first])));
+    rowValues = hlr_malloc ((numCols + 1) * sizeof (double));
+    values = arrayCreate (numCols + 1,double);
+    for (i=0;i<gctb_numRows (in);i++) {
+      gctb_row (in,i,rowValues);
+      arrayClear (values);
+      for (j=0;j<numCols;j++)
+        if (!isnan (rowValues[j]))
+          array (values,arrayMax (values),double) = rowValues[j];
+      if (arrayMax (values) == 0 || !passes (conditions,arrp (values,0,double),arrayMax (values)))
+        continue;
+      if (w != NULL)
+        gctb_addRow (w,gctb_rowId (in,i),gctb_rowDesc (in,i),rowValues);
+      else
+        gctb_printRow (gct_outRows (out),gctb_rowId (in,i),gctb_rowDesc (in,i),rowValues,
+                       numCols,in->header->type);
+      numRows++;
+    }
+    gctb_close (in);
+    if (w != NULL)
+      gctb_finish (w);
+    else
+      gct_outFinish (out,numRows);
+    return 0;
+  }
+
+  ls = lr_createFromFile (argv[first]);
+  while (line = lr_nextLine (ls)) {
+    if (lr_lineCountGet (ls) == 2) {
+      maxRows = atoi (line);
+      if ((s = strchr (line,'\t')) != NULL)
+        numCols = atoi (s + 1);
+    }
+    if (lr_lineCountGet (ls) == 3)
+      break;
+  }
+  if (line == NULL)
+    die ("%s: GCT header with less than 3 lines",argv[first]);
+  if (arg_present ("gctb")) {
+    items = textFieldtokP (line,"\t");
+    it = textCreate (arrayMax (items));
+    for (j=2;j<arrayMax (items);j++)
+      textAdd (it,textItem (items,j));
+    w = gct_gctbWriter (arg_get ("gctb"),it,GCTB_FLOAT32);
+    numCols = arrayMax (it);
+    rowValues = hlr_malloc ((numCols + 1) * sizeof (double));
+    row = stringCreate (10000);
+  }
+  else
+    out = gct_outCreate (stdout,maxRows,numCols,line);
+
+  values = arrayCreate (numCols > 0 ? numCols : 100,double);
+  /* the rows are only read, in place; a view ends with a newline, at
+     which gct_strtod stops */
+  while (line = lr_nextLineView (ls,&len)) {
+    lineEnd = line + len;
+    /* values start after the second tab */
+    if ((s = memchr (line,'\t',len)) == NULL || (s = memchr (s + 1,'\t',lineEnd - s - 1)) == NULL)
+      continue;
+    arrayClear (values);
+    while (s != NULL) {
+      s++;
+      value = gct_strtod (s,&end);
+      if (end != s && !isnan (value))
+        array (values,arrayMax (values),double) = value;
+      s = memchr (end,'\t',lineEnd - end);
+    }
+    if (arrayMax (values) == 0 || !passes (conditions,arrp (values,0,double),arrayMax (values)))
+      continue;
+    if (w != NULL) {
+      stringNCpy (row,line,len);
+      line = string (row);
+      gct_splitRow (line,&desc,&s);
+      gct_parseValues (s,rowValues,numCols,argv[first],line);
+      gctb_addRow (w,line,desc,rowValues);
+    }
+    else {
+      fwrite (line,1,len,gct_outRows (out));
+      fputc ('\n',gct_outRows (out));
+    }
+    numRows++;
+  }
+  lr_destroy (ls);
+  if (w != NULL)
+    gctb_finish (w);
+  else
+    gct_outFinish (out,numRows);
+  return 0;
+}
@@ -1,10 +1,22 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
 #include "format.h"
 #include "log.h"
-#include "linestream.h"
 #include "arg.h"
 #include "rofutil.h"
+#include "hlrmisc.h"
+#include "gtfcache.h"
 
 #define AUTHOR_MAIL "roland.schmucki@roche.com"
+#define CHUNK_SIZE 8388608    /* bytes of input parsed per thread at a time */
 
 static int verbose = 0;
 
@@ -22,6 +34,37 @@ void usagef (int level)
          "\n"
          "The above example will output all gtf fields named \"gene_name\", \"gene_synonym\", and \"product\" \n"
          "\n"
+         "\t-feature exon,CDS \n"
+         "\n"
+         "Only use lines with one of the given features (column 3) \n"
+         "\n"
+         "\t-region CHR[:BEGIN-END] \n"
+         "\n"
+         "Only use lines on chromosome CHR overlapping BEGIN-END (columns 1, 4 and 5) \n"
+         "\n"
+         "\t-threads N \n"
+         "\n"
+         "Parse the input in chunks of complete lines on N threads (default 1); \n"
+         "the output is written in input order \n"
+         "\n"
+         "\t-compile OUTFILE \n"
+         "\n"
+         "Write genes, transcripts and exons to the binary annotation cache OUTFILE \n"
+         "instead of text output. Genes are identified by gene_id, named by gene_name \n"
+         "(or gene_symbol) and described by description (or product). The cache is \n"
+         "mapped into memory by the tools reading it, e.g. annotate_loci -loci \n"
+         "\n"
+         "\t-gene-lengths OUTFILE \n"
+         "\n"
+         "Write GENE_ID and the length of the union of its exons per gene, e.g. for count2tpm -l \n"
+         "\n"
+         "\t-loci OUTFILE \n"
+         "\n"
+         "Write CHR BEGIN END STRAND GENE SYMBOL DESCRIPTION per gene sorted by coordinates, \n"
+         "e.g. for annotate_loci -loci \n"
+         "\n"
+         "-compile, -gene-lengths and -loci can be combined and are derived in one pass \n"
+         "\n"
          "\t-refseq \n"
          "\n"
          "This option will work on a gtf from refseq and do the following  \n"
@@ -36,12 +79,251 @@ void usagef (int level)
 	 "\n"
          "Note there will be a warning if there is no proper transcript accession id (mostly miRNAs) \n"
          "\n"
+         "INFILE can be gzip compressed \n"
+         "\n"
          "\n"
 	  "Report bugs and feedback to %s"
          "\n",
          arg_getProgName (),AUTHOR_MAIL);
 }
 
+/* span of a key or value within the input line, not 0-terminated */
+typedef struct {
+  char *key;
+  int keyLen;
+  char *val;
+  int valLen;
+} Attribute;
+
+/* requested output field, see -output-fields */
+typedef struct {
+  char *name;
+  int len;
+  int index;
+} Field;
+
+static int orderFieldsByName (Field *a,Field *b)
+{
+  int r = strncmp (a->name,b->name,a->len < b->len ? a->len : b->len);
+  if (r != 0)
+    return r;
+  return a->len - b->len;
+}
+
+
+/*
+  Split line of length lineLen into at most 9 tab-delimited columns
+  without copying; col[i] points to the start, len[i] is the length of
+  column i. Returns the number of columns
+*/
+static int splitColumns (char *line,int lineLen,char **col,int *len)
+{
+  char *end = line + lineLen;
+  char *pos;
+  int n = 0;
+
+  while (n < 8 && (pos = memchr (line,'\t',end - line)) != NULL) {
+    col[n] = line;
+    len[n++] = pos - line;
+    line = pos + 1;
+  }
+  col[n] = line;
+  len[n++] = end - line;
+  return n;
+}
+
+
+/*
+  Tokenize GTF column 9, e.g. 
+    gene_id "ENSG00000223972"; gene_name "DDX11L1"; level 2;
+  into key/value spans in one pass; quotes are not part of the value.
+  Returns the number of attributes in attrs
+*/
+static int tokenizeAttributes (char *s,int len,Array attrs)
+{
+  char *end = s + len;
+  Attribute *currAttr;
+
+  arrayClear (attrs);
+  for (;;) {
+    while (s < end && (*s == ' ' || *s == ';'))
+      s++;
+    if (s >= end)
+      break;
+    currAttr = arrayp (attrs,arrayMax (attrs),Attribute);
+    currAttr->key = s;
+    while (s < end && *s != ' ' && *s != ';')
+      s++;
+    currAttr->keyLen = s - currAttr->key;
+    while (s < end && *s == ' ')
+      s++;
+    if (s < end && *s == '"') {
+      currAttr->val = ++s;
+      while (s < end && *s != '"')
+        s++;
+      currAttr->valLen = s - currAttr->val;
+      if (s < end)
+        s++;
+    }
+    else {
+      currAttr->val = s;
+      while (s < end && *s != ';')
+        s++;
+      currAttr->valLen = s - currAttr->val;
+      while (currAttr->valLen > 0 && currAttr->val[currAttr->valLen-1] == ' ')
+        currAttr->valLen--;
+    }
+    while (s < end && *s != ';')
+      s++;
+  }
+  return arrayMax (attrs);
+}
+
+
+static int keyEqual (Attribute *a,char *key)
+{
+  return strncmp (a->key,key,a->keyLen) == 0 && key[a->keyLen] == '\0';
+}
+
+
+/* input file: mapped if possible, otherwise read through zlib */
+typedef struct {
+  char *map;
+  size_t size;
+  size_t pos;
+  gzFile gz;
+  char *carry;          /* incomplete last line of the previous chunk */
+  size_t carryLen;
+  size_t carrySize;
+  int eof;
+} Input;
+
+/* complete lines parsed by one thread */
+typedef struct {
+  char *data;
+  size_t len;
+  char *buffer;         /* holds data if the input is not mapped */
+  size_t bufferSize;
+  Stringa out;
+  Array attrs;
+  Attribute **values;
+  Array records;        /* of GtfcRecord, see -compile */
+} Chunk;
+
+static int refseq = 0;
+static GtfcBuilder builder = NULL; // see -compile
+static Array fields = NULL;  // of Field, sorted by name
+static Array features = NULL;  // of Field, see -feature
+static Field regionChrom;  // see -region
+static int regionBeg = 0;
+static int regionEnd = 0;
+
+
+static void openInput (char *fileName,Input *in)
+{
+  int fd;
+  struct stat st;
+  unsigned char magic[2];
+
+  memset (in,0,sizeof (Input));
+  if (strEqual (fileName,"-"))
+    fd = 0;
+  else if ((fd = open (fileName,O_RDONLY)) < 0)
+    die ("cannot open %s",fileName);
+  if (fd != 0 && fstat (fd,&st) == 0 && S_ISREG (st.st_mode) &&
+      !(pread (fd,magic,2,0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b)) {
+    in->size = st.st_size;
+    if (in->size == 0) {
+      in->eof = 1;
+      close (fd);
+      return;
+    }
+    in->map = mmap (NULL,in->size,PROT_READ,MAP_PRIVATE,fd,0);
+    if (in->map != MAP_FAILED) {
+      madvise (in->map,in->size,MADV_SEQUENTIAL);
+      close (fd);
+      return;
+    }
+    in->map = NULL;
+  }
+  // gzip or not mappable; zlib reads uncompressed input as is
+  if ((in->gz = gzdopen (fd,"r")) == NULL)
+    die ("cannot read %s",fileName);
+  gzbuffer (in->gz,1 << 20);
+}
+
+
+static void closeInput (Input *in)
+{
+  if (in->map != NULL)
+    munmap (in->map,in->size);
+  if (in->gz != NULL)
+    gzclose (in->gz);
+  free (in->carry);
+}
+
+
+static void growBuffer (char **buffer,size_t *size,size_t needed)
+{
+  if (*size >= needed)
+    return;
+  *size = needed;
+  if ((*buffer = realloc (*buffer,*size)) == NULL)
+    die ("out of memory");
+}
+
+
+/*
+  Get the next CHUNK_SIZE bytes of input extended to the end of the line.
+  Returns 0 at end of input
+*/
+static int nextChunk (Input *in,Chunk *c)
+{
+  char *end;
+  int n;
+
+  if (in->map != NULL) {
+    if (in->pos >= in->size)
+      return 0;
+    c->data = in->map + in->pos;
+    c->len = in->size - in->pos;
+    if (c->len > CHUNK_SIZE &&
+        (end = memchr (c->data + CHUNK_SIZE,'\n',c->len - CHUNK_SIZE)) != NULL)
+      c->len = end - c->data + 1;
+    in->pos += c->len;
+    return 1;
+  }
+  if (in->gz == NULL || (in->eof && in->carryLen == 0))
+    return 0;
+  growBuffer (&c->buffer,&c->bufferSize,in->carryLen + CHUNK_SIZE);
+  memcpy (c->buffer,in->carry,in->carryLen);
+  c->len = in->carryLen;
+  in->carryLen = 0;
+  for (;;) {
+    if (!in->eof) {
+      growBuffer (&c->buffer,&c->bufferSize,c->len + CHUNK_SIZE);
+      if ((n = gzread (in->gz,c->buffer + c->len,CHUNK_SIZE)) < 0)
+        die ("error reading input: %s",gzerror (in->gz,&n));
+      if (n == 0)
+        in->eof = 1;
+      c->len += n;
+    }
+    if (in->eof)
+      break;
+    if ((end = memrchr (c->buffer,'\n',c->len)) != NULL) {
+      in->carryLen = c->buffer + c->len - (end + 1);
+      growBuffer (&in->carry,&in->carrySize,in->carryLen);
+      memcpy (in->carry,end + 1,in->carryLen);
+      c->len = end + 1 - c->buffer;
+      break;
+    }
+    // line longer than the chunk: read on
+  }
+  c->data = c->buffer;
+  return c->len > 0;
+}
+
+
 /*
   0) filter away non-exon lines
 
@@ -61,201 +343,401 @@ void usagef (int level)
     gene_name
     transcript_id
 */
-void parse_refseq ()
+static void parseRefseqLine (char *line,int lineLen,Chunk *c)
 {
-  int i,j;
-  LineStream ls;
-  char *line,*pos;
-  Texta it;
-  Texta fields;
-  char *gene_id = NULL;
-  char *gene_symbol = NULL;
-  char *transcript_id = NULL;
-  char *product = NULL;
-  Stringa str = stringCreate (100);
-
-  ls = ls_createFromFile (arg_get ("gtf"));
-  while (line = ls_nextLine (ls)) {
-    if (line[0] == '#') {
-      warn ("skip line %s",line);
-      continue;
-    }
-    it = textFieldtokP (line,"\t");
-    if (arrayMax (it) < 9)
-      die ("missing fields on line %s",line);
+  int i,k,n;
+  char *col[9];
+  int len[9];
+  Attribute *currAttr;
+  Attribute *geneId,*geneName,*transcriptId,*internalId,*product;
+  char *pos;
+  int geneIdLen,transcriptIdLen;
 
-    if (!strEqual (textItem (it,2),"exon")) {
-      warn ("no exon on line %s",line);
-      textDestroy (it);
-      continue;
-    }
-    fields = textStrtokP (textItem (it,8),";");
+  if (line[0] == '#') {
+    warn ("skip line %.*s",lineLen,line);
+    return;
+  }
+  if (splitColumns (line,lineLen,col,len) < 9)
+    die ("missing fields on line %.*s",lineLen,line);
 
+  if (len[2] != 4 || strncmp (col[2],"exon",4) != 0) {
+    warn ("no exon on line %.*s",lineLen,line);
+    return;
+  }
 
-    // get gene_id
-    stringClear (str);
-    pos = strstr (textItem (it,8),"GeneID:");
-    if (pos != NULL) {
-      for (i=7;i<strlen (pos);i++) {
-        if (pos[i] == ',' || pos[i] == '"')
-          break;
-        stringCatChar (str,pos[i]);
-      }
+  /* one pass over the attributes */
+  geneId = geneName = transcriptId = internalId = product = NULL;
+  geneIdLen = transcriptIdLen = 0;
+  n = tokenizeAttributes (col[8],len[8],c->attrs);
+  for (i=0;i<n;i++) {
+    currAttr = arrp (c->attrs,i,Attribute);
+    // gene_id from GeneID:N of db_xref
+    if (geneId == NULL && currAttr->valLen > 7 && strncmp (currAttr->val,"GeneID:",7) == 0) {
+      geneId = currAttr;
+      for (k=7;k<currAttr->valLen && currAttr->val[k] != ',';k++)
+        ;
+      geneIdLen = k - 7;
     }
-    if (stringLen (str) == 0) {
-      //warn ("GeneID not valid for line %s",line);
-      gene_id = NULL;
-    }
-    else
-      strReplace (&gene_id,string (str));
-
-
-    // get transcript_id
-    stringClear (str);
-    for (i=0;i<arrayMax (fields);i++) {
-      if (strStartsWith (textItem (fields,i)," transcript_id \"") &&
-          !strStartsWith (textItem (fields,i)," transcript_id \"rna")) {
-        for (j=16;j<strlen (textItem (fields,i));j++) {
-          if (textItem (fields,i)[j] == '.')
-            break;
-          stringCatChar(str,textItem (fields,i)[j]);
-        }
-        break;
+    else if (keyEqual (currAttr,"transcript_id")) {
+      if (internalId == NULL)
+        internalId = currAttr;
+      if (transcriptId == NULL && 
+          !(currAttr->valLen >= 3 && strncmp (currAttr->val,"rna",3) == 0)) {
+        transcriptId = currAttr;
+        pos = memchr (currAttr->val,'.',currAttr->valLen);
+        transcriptIdLen = pos != NULL ? pos - currAttr->val : currAttr->valLen;
       }
     }
-    if (stringLen (str) == 0) {
-      stringClear (str);
-      //warn ("transcript_id not valid for line %s",line);
-      /* use internal transcript_id */
-      pos = strstr (textItem (it,8),"transcript_id \"");
-      if (pos != NULL) {
-        for (i=15;i<strlen (pos);i++) {
-          if (pos[i] == '"')
-            break;
-          stringCatChar (str,pos[i]);
-        }
-      }
-      strReplace (&transcript_id,string (str));
+    else if (geneName == NULL && keyEqual (currAttr,"gene_name"))
+      geneName = currAttr;
+    else if (product == NULL && keyEqual (currAttr,"product"))
+      product = currAttr;
+  }
+  /* use internal transcript_id */
+  if (transcriptId == NULL || transcriptIdLen == 0) {
+    transcriptId = internalId;
+    transcriptIdLen = internalId != NULL ? internalId->valLen : 0;
+  }
+  if (geneIdLen == 0)
+    geneId = NULL;
+  if (geneName != NULL && geneName->valLen == 0)
+    geneName = NULL;
+  if (product != NULL && product->valLen == 0)
+    product = NULL;
+
+  /* output; missing values are written as (null) as before */
+  stringAppendf (c->out,"%.*s",len[0],col[0]);
+  for (i=1;i<8;i++)
+    stringAppendf (c->out,"\t%.*s",len[i],col[i]);
+  if (geneId != NULL)
+    stringAppendf (c->out,"\tgene_id \"%.*s\";",geneIdLen,geneId->val+7);
+  else
+    stringCat (c->out,"\tgene_id \"(null)\";");
+  if (geneName != NULL)
+    stringAppendf (c->out," gene_symbol \"%.*s\";",geneName->valLen,geneName->val);
+  else
+    stringCat (c->out," gene_symbol \"(null)\";");
+  stringAppendf (c->out," transcript_id \"%.*s\";",transcriptIdLen,
+                 transcriptId != NULL ? transcriptId->val : "");
+  if (product)
+    stringAppendf (c->out," product \"%.*s\";",product->valLen,product->val);
+  stringCatChar (c->out,'\n');
+}
+
+
+/* output the values of the requested fields, see -output-fields */
+static void parseFieldsLine (char *line,int lineLen,Chunk *c)
+{
+  int i,n,index;
+  char *col[9];
+  int len[9];
+  Field *currField;
+  Field oneField;
+  Attribute *currAttr;
+
+  if (line[0] == '#') {
+    warn ("skip line %.*s",lineLen,line);
+    return;
+  }
+  if (splitColumns (line,lineLen,col,len) < 9) {
+    if (verbose)
+      warn ("missing fields on line %.*s",lineLen,line);
+    return;
+  }
+  for (i=0;i<arrayMax (fields);i++)
+    c->values[i] = NULL;
+  tokenizeAttributes (col[8],len[8],c->attrs);
+  for (i=0;i<arrayMax (c->attrs);i++) {
+    currAttr = arrp (c->attrs,i,Attribute);
+    oneField.name = currAttr->key;
+    oneField.len = currAttr->keyLen;
+    if (arrayFind (fields,&oneField,&index,(ARRAYORDERF)orderFieldsByName)) {
+      currField = arrp (fields,index,Field);
+      if (c->values[currField->index] == NULL)
+        c->values[currField->index] = currAttr;
     }
-    else
-      strReplace (&transcript_id,string (str));
-    
-
-    // get gene name (symbol)
-    stringClear (str);
-    pos = strstr (textItem (it,8),"gene_name \"");
-    if (pos != NULL) {
-      for (i=11;i<strlen (pos);i++) {
-        if (pos[i] == '"')
-          break;
-        stringCatChar (str,pos[i]);
-      }
+  }
+  n = 0;
+  for (i=0;i<arrayMax (fields);i++) {
+    if (c->values[i] == NULL)
+      continue;
+    stringAppendf (c->out,"%s%.*s",n > 0 ? "\t" : "",
+                   c->values[i]->valLen,c->values[i]->val);
+    n++;
+  }
+  if (n > 0)
+    stringCatChar (c->out,'\n');
+}
+
+
+/*
+  Collect the record for the annotation cache; the spans stay valid until
+  the chunk is added to the builder
+*/
+static void compileLine (char *line,int lineLen,Chunk *c)
+{
+  int i,n;
+  char *col[9];
+  int len[9];
+  Attribute *currAttr;
+  GtfcRecord *currRecord;
+
+  if (line[0] == '#')
+    return;
+  if (splitColumns (line,lineLen,col,len) < 9) {
+    if (verbose)
+      warn ("missing fields on line %.*s",lineLen,line);
+    return;
+  }
+  currRecord = arrayp (c->records,arrayMax (c->records),GtfcRecord);
+  memset (currRecord,0,sizeof (GtfcRecord));
+  currRecord->chrom = col[0];
+  currRecord->chromLen = len[0];
+  currRecord->start = atoi (col[3]);
+  currRecord->end = atoi (col[4]);
+  currRecord->strand = len[6] > 0 ? col[6][0] : '.';
+  currRecord->isExon = len[2] == 4 && strncmp (col[2],"exon",4) == 0;
+  n = tokenizeAttributes (col[8],len[8],c->attrs);
+  for (i=0;i<n;i++) {
+    currAttr = arrp (c->attrs,i,Attribute);
+    if (currRecord->geneId == NULL && keyEqual (currAttr,"gene_id")) {
+      currRecord->geneId = currAttr->val;
+      currRecord->geneIdLen = currAttr->valLen;
     }
-    if (stringLen (str) == 0) {
-      //warn ("gene symbol not valid for line %s",line);
-      gene_symbol = NULL;
+    else if (currRecord->transcriptId == NULL && keyEqual (currAttr,"transcript_id")) {
+      currRecord->transcriptId = currAttr->val;
+      currRecord->transcriptIdLen = currAttr->valLen;
     }
-    else
-      strReplace (&gene_symbol,string (str));
-
-    // get product ?
-    stringClear (str);
-    pos = strstr (textItem (it,8),"product \"");
-    if (pos != NULL) {
-      for (i=9;i<strlen (pos);i++) {
-        if (pos[i] == '"')
-          break;
-        stringCatChar (str,pos[i]);
-      }
+    else if (currRecord->geneName == NULL && 
+             (keyEqual (currAttr,"gene_name") || keyEqual (currAttr,"gene_symbol"))) {
+      currRecord->geneName = currAttr->val;
+      currRecord->geneNameLen = currAttr->valLen;
     }
-    if (stringLen (str) == 0) {
-      //warn ("product not valid for line %s",line);
-      product = NULL;
+    else if (keyEqual (currAttr,"description") ||
+             (currRecord->desc == NULL && keyEqual (currAttr,"product"))) {
+      currRecord->desc = currAttr->val;
+      currRecord->descLen = currAttr->valLen;
     }
+  }
+}
+
+
+static void writeGeneLengths (GtfcBuilder b,char *fileName)
+{
+  FILE *fp = hlr_fopenWrite (fileName);
+  GtfcGene *currGene;
+  int i;
+
+  for (i=0;i<arrayMax (b->genes);i++) {
+    currGene = &b->sortedGenes[b->genesById[i]];
+    if (currGene->exonLength > 0)
+      fprintf (fp,"%s\t%u\n",gtfc_builderString (b,currGene->id),currGene->exonLength);
+  }
+  if (fclose (fp) != 0)
+    die ("error writing %s",fileName);
+}
+
+
+static void writeLoci (GtfcBuilder b,char *fileName)
+{
+  FILE *fp = hlr_fopenWrite (fileName);
+  GtfcGene *currGene;
+  int i;
+
+  for (i=0;i<arrayMax (b->genes);i++) {
+    currGene = &b->sortedGenes[i];
+    fprintf (fp,"%s\t%d\t%d\t%c\t%s\t%s\t%s\n",
+             gtfc_builderString (b,arrp (b->chroms,currGene->chrom,GtfcChrom)->name),
+             currGene->start,currGene->end,currGene->strand,
+             gtfc_builderString (b,currGene->id),
+             gtfc_builderString (b,currGene->name),
+             gtfc_builderString (b,currGene->desc));
+  }
+  if (fclose (fp) != 0)
+    die ("error writing %s",fileName);
+}
+
+
+/*
+  Check -feature and -region on the first 5 columns before any attribute
+  parsing. Comments and short lines pass, the modes deal with them
+*/
+static int passesFilters (char *line,int lineLen)
+{
+  char *end = line + lineLen;
+  char *col[5];
+  int len[5];
+  char *pos;
+  int i,n;
+  Field *currFeature;
+
+  if (line[0] == '#')
+    return 1;
+  for (n=0;n<5;n++) {
+    if ((pos = memchr (line,'\t',end - line)) == NULL)
+      return 1;
+    col[n] = line;
+    len[n] = pos - line;
+    line = pos + 1;
+  }
+  if (regionChrom.name != NULL) {
+    if (len[0] != regionChrom.len || memcmp (col[0],regionChrom.name,len[0]) != 0)
+      return 0;
+    if (regionEnd > 0 && (atoi (col[3]) > regionEnd || atoi (col[4]) < regionBeg))
+      return 0;
+  }
+  if (features != NULL) {
+    for (i=0;i<arrayMax (features);i++) {
+      currFeature = arrp (features,i,Field);
+      if (len[2] == currFeature->len && memcmp (col[2],currFeature->name,len[2]) == 0)
+        break;
+    }
+    if (i == arrayMax (features))
+      return 0;
+  }
+  return 1;
+}
+
+
+/* thread function: parse all lines of a chunk into its output buffer */
+static void *parseChunk (void *arg)
+{
+  Chunk *c = arg;
+  char *line = c->data;
+  char *end = c->data + c->len;
+  char *pos;
+  int lineLen;
+
+  stringClear (c->out);
+  arrayClear (c->records);
+  while (line < end) {
+    pos = memchr (line,'\n',end - line);
+    lineLen = (pos != NULL ? pos : end) - line;
+    if (!passesFilters (line,lineLen))
+      ;
+    else if (builder != NULL)
+      compileLine (line,lineLen,c);
+    else if (refseq)
+      parseRefseqLine (line,lineLen,c);
     else
-      strReplace (&product,string (str));
-
-    /* output */
-    printf ("%s",textItem (it,0));
-    for (i=1;i<8;i++)
-      printf ("\t%s",textItem (it,i));
-    printf ("\tgene_id \"%s\";",gene_id);
-    printf (" gene_symbol \"%s\";",gene_symbol);
-    printf (" transcript_id \"%s\";",transcript_id);
-    if (product)
-      printf (" product \"%s\";",product);
-    printf ("\n");
-
-    /* destroy arrays */
-    textDestroy (fields);
-    textDestroy (it);
+      parseFieldsLine (line,lineLen,c);
+    line += lineLen + 1;
   }
-  ls_destroy (ls);
+  return NULL;
 }
 
 
 int main (int argc,char *argv[])
 {
+  int i,j,n,threads;
+  char *pos;
+  Input in;
+  Texta it;
+  Field *currField;
 
-  if (arg_init (argc,argv,"verbose,0 output-fields,1 refseq,0","gtf",
+  if (arg_init (argc,argv,"verbose,0 output-fields,1 refseq,0 threads,1 compile,1 gene-lengths,1 loci,1 "
+                "feature,1 region,1","gtf",
                 usagef) != argc)
     die ("wrong number of arguments; invoke program without params for help");
   
   if (arg_present ("verbose"))
     verbose = 1;
+  threads = arg_present ("threads") ? atoi (arg_get ("threads")) : 1;
+  if (threads < 1)
+    die ("-threads must be at least 1");
 
-
-  if (arg_present ("refseq")) {
-    parse_refseq ();
-    return 0;
+  if (arg_present ("feature")) {
+    features = arrayCreate (5,Field);
+    it = textFieldtokP (arg_get ("feature"),",");
+    for (i=0;i<arrayMax (it);i++) {
+      currField = arrayp (features,arrayMax (features),Field);
+      currField->name = hlr_strdup (textItem (it,i));
+      currField->len = strlen (currField->name);
+      currField->index = i;
+    }
+    textDestroy (it);
+  }
+  if (arg_present ("region")) {
+    regionChrom.name = hlr_strdup (arg_get ("region"));
+    if ((pos = strrchr (regionChrom.name,':')) != NULL) {
+      *pos = '\0';
+      if (sscanf (pos + 1,"%d-%d",&regionBeg,&regionEnd) != 2 ||
+          regionBeg < 1 || regionEnd < regionBeg)
+        die ("invalid -region %s, expected CHR:BEGIN-END",arg_get ("region"));
+    }
+    regionChrom.len = strlen (regionChrom.name);
   }
 
-  /* output fields */
-  int i,j,k,n;
-  LineStream ls;
-  char *line;
-  Texta it;
-  char *pos;
-  Texta fields;
-  Stringa str = stringCreate (100);
-  
-  fields = textFieldtokP (arg_get ("output-fields"),",");
-  ls = ls_createFromFile (arg_get ("gtf"));
-  while (line = ls_nextLine (ls)) {
-    if (line[0] == '#') {
-      warn ("skip line %s",line);
-      continue;
+  if (arg_present ("compile") || arg_present ("gene-lengths") || arg_present ("loci")) {
+    if (arg_present ("refseq") || arg_present ("output-fields"))
+      die ("-compile, -gene-lengths and -loci cannot be combined with -refseq or -output-fields");
+    builder = gtfc_createBuilder ();
+  }
+  else if (arg_present ("refseq"))
+    refseq = 1;
+  else {
+    /* requested fields sorted by name for an exact key lookup */
+    fields = arrayCreate (10,Field);
+    it = textFieldtokP (arg_get ("output-fields"),",");
+    for (i=0;i<arrayMax (it);i++) {
+      currField = arrayp (fields,arrayMax (fields),Field);
+      currField->name = hlr_strdup (textItem (it,i));
+      currField->len = strlen (currField->name);
+      currField->index = i;
     }
-    it = textFieldtokP (line,"\t");
-    /*      n=1;
-            printf ("%s",textItem (it,0));
-            for (i=1;i<8;i++) 
-            printf ("\t%s",textItem (it,i));*/
+    textDestroy (it);
+    arraySort (fields,(ARRAYORDERF)orderFieldsByName);
+  }
+
+  Chunk chunks[threads];
+  pthread_t tids[threads];
+  for (i=0;i<threads;i++) {
+    memset (&chunks[i],0,sizeof (Chunk));
+    chunks[i].out = stringCreate (CHUNK_SIZE / 4);
+    chunks[i].attrs = arrayCreate (30,Attribute);
+    chunks[i].records = arrayCreate (builder != NULL ? 100000 : 1,GtfcRecord);
+    if (fields != NULL)
+      chunks[i].values = hlr_calloc (arrayMax (fields) + 1,sizeof (Attribute *));
+  }
+
+  openInput (arg_get ("gtf"),&in);
+  for (;;) {
     n = 0;
-    for (i=0;i<arrayMax (fields);i++) {
-      pos = strstr (textItem (it,8),textItem (fields,i));
-      if (pos != NULL) {
-        stringClear (str);
-        k = 0;
-        for (j=0;j<(int)strlen (pos);j++) {
-          if (k == 2)
-            break;
-          else if (pos[j] == '"')
-            k++;
-          else if (k == 1)
-            stringCatChar (str,pos[j]);
-        }
-        if (n > 0)
-          printf ("\t");
-        printf ("%s",string (str));
-        n++;
-      }
+    while (n < threads && nextChunk (&in,&chunks[n]))
+      n++;
+    if (n == 0)
+      break;
+    if (n == 1)
+      parseChunk (&chunks[0]);
+    else {
+      for (i=0;i<n;i++)
+        if (pthread_create (&tids[i],NULL,parseChunk,&chunks[i]) != 0)
+          die ("cannot create thread");
+      for (i=0;i<n;i++)
+        pthread_join (tids[i],NULL);
     }
-    if (n > 0)
-      printf ("\n");
-    textDestroy (it);
+    if (builder != NULL)
+      for (i=0;i<n;i++)
+        for (j=0;j<arrayMax (chunks[i].records);j++)
+          gtfc_add (builder,arrp (chunks[i].records,j,GtfcRecord));
+    for (i=0;i<n;i++)
+      if (fwrite (string (chunks[i].out),1,stringLen (chunks[i].out),stdout) != 
+          stringLen (chunks[i].out))
+        die ("error writing output");
+  }
+  closeInput (&in);
+  if (builder != NULL) {
+    gtfc_finish (builder);
+    if (arg_present ("compile"))
+      gtfc_write (builder,arg_get ("compile"));
+    if (arg_present ("gene-lengths"))
+      writeGeneLengths (builder,arg_get ("gene-lengths"));
+    if (arg_present ("loci"))
+      writeLoci (builder,arg_get ("loci"));
+    gtfc_destroyBuilder (builder);
   }
-  ls_destroy (ls);
+  if (fflush (stdout) != 0)
+    die ("error writing output");
 
   return 0;
 }
@@ -0,0 +1,233 @@
+#include "format.h"
+#include "log.h"
+#include "linereader.h"
+#include "arg.h"
+#include "strhash.h"
+#include "gct.h"
+
+#define AUTHOR_MAIL "roland.schmucki@roche.com"
+#define OUTPUT_BUFFER_SIZE 1048576
+
+
+void usagef (int level)
+{
+  romsg ("Description: \n"
+         "\n"
+         "Re-order samples (columns) in the GCT file by the names given in the SAMPLE file. \n"
+         "Only the samples of the SAMPLE file are output, in its order. \n"
+         "\n"
+         "Usage: %s [-gctb FILE] -g GCT_FILE -s SAMPLE_FILE \n"
+         "\n"
+         "Mandatory parameters: \n"
+         "\n"
+         "\t-g GCT_FILE     input GCT file, text or binary (.gctb, see gct2gctb) \n"
+         "\t-s SAMPLE_FILE  input SAMPLE file with re-ordered sample names (1st column) \n"
+         "\n"
+         "Optional parameters: \n"
+         "\n"
+         "\t-gctb FILE      write the result as binary GCT to FILE instead of the standard \n"
+         "\t                output; values are float32, or of the input type for .gctb input \n"
+         "\n"
+         "Report bugs and feedback to %s \n",
+         arg_getProgName (),AUTHOR_MAIL);
+}
+
+
+
+/* finds the starts of the first n fields of line; returns the number found */
+static int findFields (char *line,char **starts,int n)
+{
+  char *s = line;
+  int i = 0;
+
+  while (i < n) {
+    starts[i++] = s;
+    if ((s = strchr (s,'\t')) == NULL)
+      break;
+    s++;
+  }
+  return i;
+}
+
+
+
+/* writes field i of line, given the field starts */
+static void writeField (char **starts,int numFields,int i)
+{
+  char *start = starts[i];
+  char *end;
+
+  if (i + 1 < numFields)
+    end = starts[i+1] - 1;
+  else if ((end = strchr (start,'\t')) == NULL)
+    end = start + strlen (start);
+  fwrite (start,1,end - start,stdout);
+}
+
+
+
+/*
+  Permutation from the sample file, computed once: per output column the
+  column of the sample name, given names and the column of each name id
+*/
+static Array readPerm (char *sampleFile,StrHash names,int *nameCol,char *gctFile)
+{
+  Array perm = arrayCreate (strhash_count (names),int);
+  LineReader sampleLs;
+  char *sample;
+  int id,len;
+
+  sampleLs = lr_createFromFile (sampleFile);
+  while (sample = lr_nextLine (sampleLs)) {
+    len = strcspn (sample,"\t");
+    if (len == 0)
+      continue;
+    if ((id = strhash_find (names,sample,len)) < 0)
+      die ("sample %.*s not in %s",len,sample,gctFile);
+    array (perm,arrayMax (perm),int) = nameCol[id];
+  }
+  lr_destroy (sampleLs);
+  return perm;
+}
+
+
+
+/* reorders the binary GCT fileName, as text GCT on stdout or as binary GCT to outFile */
+static void reorderGctb (char *fileName,char *sampleFile,char *outFile)
+{
+  Gctb in = gctb_open (fileName);
+  StrHash names = strhash_create (gctb_numCols (in));
+  int *nameCol = hlr_malloc ((gctb_numCols (in) + 1) * sizeof (int));
+  double *values = hlr_malloc ((gctb_numCols (in) + 1) * sizeof (double));
+  double *outValues;
+  Texta sampleNames;
+  Array perm;
+  GctbWriter w = NULL;
+  long i;
+  int j;
+
+  for (j=0;j<gctb_numCols (in);j++)
+    nameCol[strhash_add (names,gctb_colName (in,j),strlen (gctb_colName (in,j)))] = j;
+  perm = readPerm (sampleFile,names,nameCol,fileName);
+  sampleNames = textCreate (arrayMax (perm));
+  for (j=0;j<arrayMax (perm);j++)
+    textAdd (sampleNames,gctb_colName (in,arru (perm,j,int)));
+  outValues = hlr_malloc ((arrayMax (perm) + 1) * sizeof (double));
+  if (outFile != NULL)
+    w = gct_gctbWriter (outFile,sampleNames,in->header->type);
+  else
+    printf ("#1.2\n%ld\t%d\n%s\n",gctb_numRows (in),arrayMax (perm),gct_headerLine (sampleNames));
+  for (i=0;i<gctb_numRows (in);i++) {
+    gctb_row (in,i,values);
+    for (j=0;j<arrayMax (perm);j++)
+      outValues[j] = values[arru (perm,j,int)];
+    if (w != NULL)
+      gctb_addRow (w,gctb_rowId (in,i),gctb_rowDesc (in,i),outValues);
+    else
+      gctb_printRow (stdout,gctb_rowId (in,i),gctb_rowDesc (in,i),outValues,arrayMax (perm),
+                     in->header->type);
+  }
+  if (w != NULL)
+    gctb_finish (w);
+  gctb_close (in);
+  hlr_free (values);
+  hlr_free (outValues);
+}
+
+
+
+int main (int argc,char *argv[])
+{
+  LineReader ls;
+  char *line,*s,*desc;
+  StrHash names;
+  int *nameCol;             /* GCT field of each header name id */
+  Array perm;               /* of int, GCT field per output column */
+  char **starts;
+  int numStarts,numFields;
+  int numRows = 0;
+  GctbWriter w = NULL;
+  Texta sampleNames;
+  Stringa name;
+  double *values,*outValues;
+  int i;
+
+  if (arg_init (argc,argv,"gctb,1","g s",usagef) != argc)
+    die ("wrong number of arguments; invoke program without params for help");
+  setvbuf (stdout,NULL,_IOFBF,OUTPUT_BUFFER_SIZE);
+  if (gctb_isGctb (arg_get ("g"))) {
+    reorderGctb (arg_get ("g"),arg_get ("s"),arg_present ("gctb") ? arg_get ("gctb") : NULL);
+    if (fflush (stdout) != 0)
+      die ("error writing output");
+    return 0;
+  }
+
+  ls = lr_createFromFile (arg_get ("g"));
+  while (line = lr_nextLine (ls)) {
+    if (lr_lineCountGet (ls) == 2)
+      numRows = atoi (line);
+    if (lr_lineCountGet (ls) == 3)
+      break;
+  }
+  if (line == NULL)
+    die ("%s: GCT header with less than 3 lines",arg_get ("g"));
+
+  /* header: field of every sample name (the last one if repeated) */
+  numStarts = 1;
+  for (s=line;(s = strchr (s,'\t')) != NULL;s++)
+    numStarts++;
+  starts = hlr_malloc (numStarts * sizeof (char *));
+  numFields = findFields (line,starts,numStarts);
+  names = strhash_create (numFields);
+  nameCol = hlr_malloc (numFields * sizeof (int));
+  for (i=2;i<numFields;i++)
+    nameCol[strhash_add (names,starts[i],strcspn (starts[i],"\t"))] = i;
+
+  perm = readPerm (arg_get ("s"),names,nameCol,arg_get ("g"));
+
+  if (arg_present ("gctb")) {
+    /* the values of the whole row are parsed, then permuted */
+    sampleNames = textCreate (arrayMax (perm));
+    name = stringCreate (100);
+    for (i=0;i<arrayMax (perm);i++) {
+      s = starts[arru (perm,i,int)];
+      stringNCpy (name,s,strcspn (s,"\t"));
+      textAdd (sampleNames,string (name));
+    }
+    w = gct_gctbWriter (arg_get ("gctb"),sampleNames,GCTB_FLOAT32);
+    values = hlr_malloc (numFields * sizeof (double));
+    outValues = hlr_malloc ((arrayMax (perm) + 1) * sizeof (double));
+    while (line = lr_nextLine (ls)) {
+      gct_splitRow (line,&desc,&s);
+      gct_parseValues (s,values,numFields - 2,arg_get ("g"),line);
+      for (i=0;i<arrayMax (perm);i++)
+        outValues[i] = values[arru (perm,i,int) - 2];
+      gctb_addRow (w,line,desc,outValues);
+    }
+    lr_destroy (ls);
+    gctb_finish (w);
+    return 0;
+  }
+
+  printf ("#1.2\n%d\t%d\n",numRows,arrayMax (perm));
+  for (;;) {
+    /* row: name and description, then the fields in permuted order */
+    writeField (starts,numFields,0);
+    putchar ('\t');
+    if (numFields > 1)
+      writeField (starts,numFields,1);
+    for (i=0;i<arrayMax (perm);i++) {
+      putchar ('\t');
+      if (arru (perm,i,int) < numFields)
+        writeField (starts,numFields,arru (perm,i,int));
+    }
+    putchar ('\n');
+    if ((line = lr_nextLine (ls)) == NULL)
+      break;
+    numFields = findFields (line,starts,numStarts);
+  }
+  lr_destroy (ls);
+  if (fflush (stdout) != 0)
+    die ("error writing output");
+  return 0;
+}
@@ -0,0 +1,136 @@
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <sys/stat.h>
+#include "format.h"
+#include "log.h"
+#include "linereader.h"
+#include "arg.h"
+#include "hlrmisc.h"
+#include "strhash.h"
+
+#define AUTHOR_MAIL "roland.schmucki@roche.com"
+#define COPY_BUFFER_SIZE 1048576
+
+
+void usagef (int level)
+{
+  romsg ("Description: \n"
+         "\n"
+         "Replace the sample names in the GCT file by the names given in the SAMPLE file. \n"
+         "Only the header is rewritten; the data rows are copied verbatim. \n"
+         "\n"
+         "Usage: %s -g GCT_FILE -s SAMPLE_FILE \n"
+         "\n"
+         "Mandatory parameters: \n"
+         "\n"
+         "\t-g GCT_FILE     input GCT file (- for stdin) \n"
+         "\t-s SAMPLE_FILE  input SAMPLE file, 2 columns required: \n"
+         "\t                  1st: sample names in input GCT file \n"
+         "\t                  2nd: sample names in output GCT file \n"
+         "\t                Samples not in the SAMPLE file keep their name. \n"
+         "\n"
+         "Report bugs and feedback to %s \n",
+         arg_getProgName (),AUTHOR_MAIL);
+}
+
+
+
+/*
+  Copies the rest of in from offset to stdout; in the kernel with
+  copy_file_range if in is a regular file, else through a buffer
+*/
+static void copyRest (FILE *in,off_t offset)
+{
+  struct stat st;
+  char *buffer;
+  ssize_t n;
+  size_t len;
+
+  fflush (stdout);
+  if (fstat (fileno (in),&st) == 0 && S_ISREG (st.st_mode) && offset >= 0) {
+    while (offset < st.st_size) {
+      n = copy_file_range (fileno (in),&offset,fileno (stdout),NULL,st.st_size - offset,0);
+      if (n <= 0)
+        break;  /* e.g. stdout is a pipe or the kernel is too old */
+    }
+    if (offset >= st.st_size)
+      return;
+    if (fseeko (in,offset,SEEK_SET) != 0)
+      die ("cannot seek in input file");
+  }
+  buffer = hlr_malloc (COPY_BUFFER_SIZE);
+  while ((len = fread (buffer,1,COPY_BUFFER_SIZE,in)) > 0)
+    if (fwrite (buffer,1,len,stdout) != len)
+      die ("error writing output");
+  hlr_free (buffer);
+}
+
+
+
+int main (int argc,char *argv[])
+{
+  LineReader ls;
+  FILE *in;
+  char *line = NULL;
+  size_t size = 0;
+  ssize_t len;
+  char *s,*tab;
+  StrHash oldNames;
+  Texta newNames = textCreate (100);
+  int numLines = 0;
+  int i,id;
+
+  if (arg_init (argc,argv,"","g s",usagef) != argc)
+    die ("wrong number of arguments; invoke program without params for help");
+
+  /* new label per old name, computed once */
+  oldNames = strhash_create (1000);
+  ls = lr_createFromFile (arg_get ("s"));
+  while (s = lr_nextLine (ls)) {
+    if ((tab = strchr (s,'\t')) == NULL)
+      continue;
+    id = strhash_add (oldNames,s,tab - s);
+    if ((s = strchr (tab + 1,'\t')) != NULL)
+      *s = '\0';
+    if (id < arrayMax (newNames)) {
+      hlr_free (textItem (newNames,id));
+      textItem (newNames,id) = hlr_strdup (tab + 1);
+    }
+    else
+      textAdd (newNames,tab + 1);
+  }
+  lr_destroy (ls);
+
+  /* the first 3 lines are rewritten, the rest is copied */
+  in = strEqual (arg_get ("g"),"-") ? stdin : hlr_fopenRead (arg_get ("g"));
+  while (numLines < 3 && (len = getline (&line,&size,in)) > 0) {
+    numLines++;
+    if (numLines < 3) {
+      fputs (line,stdout);
+      continue;
+    }
+    if (line[len-1] == '\n')
+      line[--len] = '\0';
+    i = 0;
+    for (s=line;s!=NULL;s=tab) {
+      if ((tab = strchr (s,'\t')) != NULL)
+        *tab++ = '\0';
+      if (i > 0)
+        putchar ('\t');
+      if (i >= 2 && (id = strhash_find (oldNames,s,strlen (s))) >= 0)
+        fputs (textItem (newNames,id),stdout);
+      else
+        fputs (s,stdout);
+      i++;
+    }
+    putchar ('\n');
+  }
+  if (numLines < 3)
+    die ("%s: GCT header with less than 3 lines",arg_get ("g"));
+  copyRest (in,ftello (in));
+  if (in != stdin)
+    fclose (in);
+  if (fflush (stdout) != 0)
+    die ("error writing output");
+  return 0;
+}
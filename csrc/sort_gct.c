@@ -0,0 +1,383 @@
+#include <unistd.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include "format.h"
+#include "log.h"
+#include "linereader.h"
+#include "arg.h"
+#include "gct.h"
+
+#define AUTHOR_MAIL "roland.schmucki@roche.com"
+#define OUTPUT_BUFFER_SIZE 1048576
+#define MAX_RUNS 256     /* runs merged at once; more are merged in rounds */
+
+
+/* one data row */
+typedef struct {
+  char *line;
+  char *key;         /* column 1 or 2, not 0-terminated */
+  int keyLen;
+  uint64_t prefix[2];  /* first 16 bytes of the key, big-endian, 0-padded */
+  double num;        /* key as number with -n */
+  long seq;          /* input order, breaks ties */
+} Rec;
+
+/* rows sorted by one thread */
+typedef struct {
+  Rec *recs;
+  int n;
+} Chunk;
+
+/* input of the merge: a sorted chunk in memory or a run file */
+typedef struct {
+  int index;         /* ties go to the lower index, i.e. to the earlier rows */
+  Rec *recs;
+  int n;
+  int pos;
+  LineReader ls;
+  Rec rec;           /* current row */
+} Source;
+
+static int keyCol = 1;
+static int numeric = 0;
+static int reverse = 0;
+
+
+void usagef (int level)
+{
+  romsg ("Description: \n"
+         "\n"
+         "Sorts input GCT file by column 1 (default) or 2 in numeric or alphabetic (default) order. \n"
+         "Rows with equal keys keep their input order. Rows are sorted in memory chunks \n"
+         "on several threads; if the file does not fit into -memory, sorted runs are \n"
+         "written to temporary files and merged. \n"
+         "\n"
+         "Usage: %s [-c 1|2] [-n] [-r] [-memory MB] [-threads N] [-tmpdir DIR] -g GCT_FILE \n"
+         "\n"
+         "Mandatory parameters: \n"
+         "\n"
+         "\t-g GCT_FILE  input GCT file (- for stdin) \n"
+         "\n"
+         "Optional parameters: \n"
+         "\n"
+         "\t-c           column 1 or 2 (default is 1) \n"
+         "\t-n           order numerically (default is alphabetically, bytewise) \n"
+         "\t-r           reverse order \n"
+         "\t-memory MB   memory for the rows sorted at once (default: 1024) \n"
+         "\t-threads N   number of threads sorting in parallel (default: 1) \n"
+         "\t-tmpdir DIR  directory for the temporary files (default: $TMPDIR or /tmp) \n"
+         "\n"
+         "Report bugs and feedback to %s \n",
+         arg_getProgName (),AUTHOR_MAIL);
+}
+
+
+
+static void setKey (Rec *r)
+{
+  char *s = r->line;
+  char *end;
+  int i;
+
+  if (keyCol == 2) {
+    s = strchr (s,'\t');
+    s = s == NULL ? r->line + strlen (r->line) : s + 1;
+  }
+  r->key = s;
+  r->keyLen = strcspn (s,"\t");
+  /* most comparisons are decided by the prefix without touching the line */
+  r->prefix[0] = r->prefix[1] = 0;
+  for (i=0;i<16 && i<r->keyLen;i++)
+    r->prefix[i/8] |= (uint64_t)(unsigned char)s[i] << (56 - 8 * (i % 8));
+  if (numeric) {
+    /* like sort -n, keys that are not numbers count as 0 */
+    r->num = gct_strtod (s,&end);
+    if (isnan (r->num))
+      r->num = 0;
+  }
+}
+
+
+
+static int compareKeys (Rec *a,Rec *b)
+{
+  int c;
+
+  if (numeric)
+    c = a->num < b->num ? -1 : (a->num > b->num);
+  else if (a->prefix[0] != b->prefix[0])
+    c = a->prefix[0] < b->prefix[0] ? -1 : 1;
+  else if (a->prefix[1] != b->prefix[1])
+    c = a->prefix[1] < b->prefix[1] ? -1 : 1;
+  else {
+    c = memcmp (a->key,b->key,a->keyLen < b->keyLen ? a->keyLen : b->keyLen);
+    if (c == 0)
+      c = a->keyLen - b->keyLen;
+  }
+  return reverse ? -c : c;
+}
+
+
+
+static int orderRecs (Rec *a,Rec *b)
+{
+  int c = compareKeys (a,b);
+
+  if (c != 0)
+    return c;
+  return a->seq < b->seq ? -1 : (a->seq > b->seq);
+}
+
+
+
+static void *sortChunk (void *arg)
+{
+  Chunk *chunk = arg;
+
+  qsort (chunk->recs,chunk->n,sizeof (Rec),
+         (int (*)(const void *,const void *))orderRecs);
+  return NULL;
+}
+
+
+
+/* sorts recs in n chunks in parallel */
+static void sortChunks (Array recs,Chunk *chunks,int n)
+{
+  pthread_t tids[n];
+  int i,start,end;
+
+  for (i=0;i<n;i++) {
+    start = (long)arrayMax (recs) * i / n;
+    end = (long)arrayMax (recs) * (i + 1) / n;
+    chunks[i].recs = arrp (recs,0,Rec) + start;
+    chunks[i].n = end - start;
+  }
+  if (n == 1)
+    sortChunk (&chunks[0]);
+  else {
+    for (i=0;i<n;i++)
+      if (pthread_create (&tids[i],NULL,sortChunk,&chunks[i]) != 0)
+        die ("cannot create thread");
+    for (i=0;i<n;i++)
+      pthread_join (tids[i],NULL);
+  }
+}
+
+
+
+/* moves a source to its next row; returns 0 at its end */
+static int nextRec (Source *s)
+{
+  if (s->ls != NULL) {
+    if ((s->rec.line = lr_nextLine (s->ls)) == NULL)
+      return 0;
+    setKey (&s->rec);
+    return 1;
+  }
+  if (s->pos == s->n)
+    return 0;
+  s->rec = s->recs[s->pos++];
+  return 1;
+}
+
+
+
+static int sourceLess (Source *a,Source *b)
+{
+  int c = compareKeys (&a->rec,&b->rec);
+
+  if (c != 0)
+    return c < 0;
+  return a->index < b->index;
+}
+
+
+
+static void siftDown (Source **heap,int n,int i)
+{
+  Source *tmp;
+  int child;
+
+  for (;;) {
+    child = 2 * i + 1;
+    if (child >= n)
+      return;
+    if (child + 1 < n && sourceLess (heap[child+1],heap[child]))
+      child++;
+    if (!sourceLess (heap[child],heap[i]))
+      return;
+    tmp = heap[i];
+    heap[i] = heap[child];
+    heap[child] = tmp;
+    i = child;
+  }
+}
+
+
+
+/* k-way merge of the sources to fp */
+static void mergeSources (Source *sources,int n,FILE *fp)
+{
+  Source *heap[n];
+  int i;
+  int numHeap = 0;
+
+  for (i=0;i<n;i++) {
+    sources[i].index = i;
+    if (nextRec (&sources[i]))
+      heap[numHeap++] = &sources[i];
+  }
+  for (i=numHeap/2-1;i>=0;i--)
+    siftDown (heap,numHeap,i);
+  while (numHeap > 0) {
+    fputs (heap[0]->rec.line,fp);
+    fputc ('\n',fp);
+    if (!nextRec (heap[0]))
+      heap[0] = heap[--numHeap];
+    siftDown (heap,numHeap,0);
+  }
+}
+
+
+
+static FILE *createRun (Texta runs,char *tmpDir)
+{
+  Stringa name = stringCreate (100);
+  int fd;
+  FILE *fp;
+
+  stringPrintf (name,"%s/sort_gct.XXXXXX",tmpDir);
+  if ((fd = mkstemp (string (name))) == -1 || (fp = fdopen (fd,"w")) == NULL)
+    die ("cannot create temporary file in %s",tmpDir);
+  setvbuf (fp,NULL,_IOFBF,OUTPUT_BUFFER_SIZE);
+  textAdd (runs,string (name));
+  stringDestroy (name);
+  return fp;
+}
+
+
+
+static void closeRun (FILE *fp)
+{
+  if (fflush (fp) != 0 || fclose (fp) != 0)
+    die ("error writing temporary file");
+}
+
+
+
+/*
+  Merges the runs first .. first+n-1 and the in-memory chunks to fp; the
+  merged runs are removed
+*/
+static void mergeRuns (Texta runs,int first,int n,Chunk *chunks,int numChunks,FILE *fp)
+{
+  Source *sources = hlr_calloc (n + numChunks,sizeof (Source));
+  int i;
+
+  for (i=0;i<n;i++)
+    sources[i].ls = lr_createFromFile (textItem (runs,first + i));
+  for (i=0;i<numChunks;i++) {
+    sources[n+i].recs = chunks[i].recs;
+    sources[n+i].n = chunks[i].n;
+  }
+  mergeSources (sources,n + numChunks,fp);
+  for (i=0;i<n;i++) {
+    lr_destroy (sources[i].ls);
+    unlink (textItem (runs,first + i));
+  }
+  hlr_free (sources);
+}
+
+
+
+int main (int argc,char *argv[])
+{
+  LineReader ls;
+  char *line;
+  char *arena;
+  size_t arenaSize,used,len;
+  int lineLen;
+  Array recs;
+  Rec *currRec;
+  Chunk *chunks;
+  Texta runs = textCreate (10);
+  Texta merged;
+  char *tmpDir;
+  FILE *fp;
+  int numThreads = 1;
+  long seq = 0;
+
+  if (arg_init (argc,argv,"c,1 n,0 r,0 memory,1 threads,1 tmpdir,1","g",usagef) != argc)
+    die ("wrong number of arguments; invoke program without params for help");
+  if (arg_present ("c"))
+    keyCol = atoi (arg_get ("c"));
+  if (keyCol != 1 && keyCol != 2)
+    die ("Input parameter c for column must be 1 or 2");
+  numeric = arg_present ("n");
+  reverse = arg_present ("r");
+  if (arg_present ("threads"))
+    numThreads = atoi (arg_get ("threads"));
+  if (numThreads < 1)
+    die ("-threads must be at least 1");
+  arenaSize = (size_t)(arg_present ("memory") ? atoi (arg_get ("memory")) : 1024) << 20;
+  if (arenaSize == 0)
+    die ("-memory must be at least 1");
+  if (arg_present ("tmpdir"))
+    tmpDir = arg_get ("tmpdir");
+  else if ((tmpDir = getenv ("TMPDIR")) == NULL)
+    tmpDir = "/tmp";
+  setvbuf (stdout,NULL,_IOFBF,OUTPUT_BUFFER_SIZE);
+
+  arena = hlr_malloc (arenaSize);
+  recs = arrayCreate (100000,Rec);
+  chunks = hlr_calloc (numThreads,sizeof (Chunk));
+  ls = lr_createFromFile (arg_get ("g"));
+  used = 0;
+  for (;;) {
+    /* the rows are copied into the arena straight from the input */
+    line = lr_nextLineView (ls,&lineLen);
+    if (line != NULL && lr_lineCountGet (ls) <= 3) {
+      fwrite (line,1,lineLen,stdout);
+      putchar ('\n');
+      continue;
+    }
+    len = line != NULL ? lineLen + 1 : 0;
+    if (line == NULL || (used + len > arenaSize && arrayMax (recs) > 0)) {
+      sortChunks (recs,chunks,numThreads);
+      if (line == NULL) {
+        /* the last rows are merged from memory with the runs */
+        mergeRuns (runs,0,arrayMax (runs),chunks,numThreads,stdout);
+        break;
+      }
+      fp = createRun (runs,tmpDir);
+      mergeRuns (runs,0,0,chunks,numThreads,fp);
+      closeRun (fp);
+      arrayClear (recs);
+      used = 0;
+      if (arrayMax (runs) == MAX_RUNS) {
+        /* merge the runs into one to bound the number of open files */
+        merged = runs;
+        runs = textCreate (10);
+        fp = createRun (runs,tmpDir);
+        mergeRuns (merged,0,arrayMax (merged),NULL,0,fp);
+        closeRun (fp);
+        textDestroy (merged);
+      }
+    }
+    if (len > arenaSize)
+      die ("line %d is longer than -memory",lr_lineCountGet (ls));
+    memcpy (arena + used,line,lineLen);
+    arena[used+lineLen] = '\0';
+    currRec = arrayp (recs,arrayMax (recs),Rec);
+    currRec->line = arena + used;
+    currRec->seq = seq++;
+    setKey (currRec);
+    used += len;
+  }
+  lr_destroy (ls);
+  if (fflush (stdout) != 0)
+    die ("error writing output");
+  return 0;
+}
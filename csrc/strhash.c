@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <string.h>
+#include "log.h"
+#include "hlrmisc.h"
+#include "strhash.h"
+
+#define ARENA_BLOCK_SIZE 1048576
+
+typedef struct Block {
+  struct Block *next;
+  char data[];
+} Block;
+
+
+static unsigned int hashKey (char *key,int len)
+{
+  unsigned int h = 2166136261u; // FNV-1a
+  int i;
+
+  for (i=0;i<len;i++) {
+    h ^= (unsigned char)key[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+
+static void *allocOrDie (void *p,size_t size)
+{
+  if ((p = realloc (p,size)) == NULL)
+    die ("out of memory");
+  return p;
+}
+
+
+StrHash strhash_create (int initSize)
+{
+  StrHash h = hlr_calloc (1,sizeof (StrHashStruct));
+
+  h->numSlots = 16;
+  while (h->numSlots < 2 * initSize)
+    h->numSlots *= 2;
+  h->slots = hlr_calloc (h->numSlots,sizeof (int));
+  h->size = initSize > 16 ? initSize : 16;
+  h->keys = hlr_malloc (h->size * sizeof (char *));
+  h->lens = hlr_malloc (h->size * sizeof (int));
+  h->hashes = hlr_malloc (h->size * sizeof (unsigned int));
+  return h;
+}
+
+
+void strhash_destroy (StrHash h)
+{
+  Block *b,*next;
+
+  if (h == NULL)
+    return;
+  for (b=h->blocks;b!=NULL;b=next) {
+    next = b->next;
+    free (b);
+  }
+  free (h->slots);
+  free (h->keys);
+  free (h->lens);
+  free (h->hashes);
+  free (h);
+}
+
+
+static int findSlot (StrHash h,char *key,int len,unsigned int hash)
+{
+  int mask = h->numSlots - 1;
+  int s = hash & mask;
+  int id;
+
+  while ((id = h->slots[s] - 1) >= 0) {
+    if (h->hashes[id] == hash && h->lens[id] == len &&
+        memcmp (h->keys[id],key,len) == 0)
+      return s;
+    s = (s + 1) & mask;
+  }
+  return s;
+}
+
+
+/* Returns the id of key, -1 if not present */
+int strhash_find (StrHash h,char *key,int len)
+{
+  return h->slots[findSlot (h,key,len,hashKey (key,len))] - 1;
+}
+
+
+static char *copyKey (StrHash h,char *key,int len)
+{
+  Block *b;
+  char *copy;
+  int size;
+
+  if (h->arena == NULL || h->arenaUsed + len + 1 > h->arenaSize) {
+    size = len + 1 > ARENA_BLOCK_SIZE ? len + 1 : ARENA_BLOCK_SIZE;
+    b = hlr_malloc (sizeof (Block) + size);
+    b->next = h->blocks;
+    h->blocks = b;
+    h->arena = b->data;
+    h->arenaUsed = 0;
+    h->arenaSize = size;
+  }
+  copy = h->arena + h->arenaUsed;
+  memcpy (copy,key,len);
+  copy[len] = '\0';
+  h->arenaUsed += len + 1;
+  return copy;
+}
+
+
+static void grow (StrHash h)
+{
+  int i,s,mask;
+
+  free (h->slots);
+  h->numSlots *= 2;
+  h->slots = hlr_calloc (h->numSlots,sizeof (int));
+  mask = h->numSlots - 1;
+  for (i=0;i<h->count;i++) {
+    s = h->hashes[i] & mask;
+    while (h->slots[s] != 0)
+      s = (s + 1) & mask;
+    h->slots[s] = i + 1;
+  }
+}
+
+
+/* Returns the id of key, adding it if not yet present */
+int strhash_add (StrHash h,char *key,int len)
+{
+  unsigned int hash = hashKey (key,len);
+  int s = findSlot (h,key,len,hash);
+  int id;
+
+  if (h->slots[s] != 0)
+    return h->slots[s] - 1;
+  if (h->count == h->size) {
+    h->size *= 2;
+    h->keys = allocOrDie (h->keys,h->size * sizeof (char *));
+    h->lens = allocOrDie (h->lens,h->size * sizeof (int));
+    h->hashes = allocOrDie (h->hashes,h->size * sizeof (unsigned int));
+  }
+  id = h->count++;
+  h->keys[id] = copyKey (h,key,len);
+  h->lens[id] = len;
+  h->hashes[id] = hash;
+  h->slots[s] = id + 1;
+  if (2 * h->count > h->numSlots)
+    grow (h);
+  return id;
+}
@@ -0,0 +1,32 @@
+#ifndef STRHASH_H
+#define STRHASH_H
+
+/*
+  Hash table of strings with dense ids: the n-th distinct key added gets
+  id n. Keys are given with their length, so spans of a larger buffer
+  can be looked up without copying; stored keys are 0-terminated copies.
+*/
+
+typedef struct {
+  int *slots;        /* id + 1 per slot, 0 if empty */
+  unsigned int *hashes; /* hash per id */
+  int numSlots;      /* power of 2 */
+  char **keys;       /* per id, points into the key arena */
+  int *lens;
+  int count;
+  int size;          /* allocated ids */
+  char *arena;       /* current block for key copies */
+  int arenaUsed;
+  int arenaSize;
+  void *blocks;      /* list of arena blocks */
+} StrHashStruct,*StrHash;
+
+extern StrHash strhash_create (int initSize);
+extern void strhash_destroy (StrHash h);
+extern int strhash_add (StrHash h,char *key,int len);
+extern int strhash_find (StrHash h,char *key,int len);
+#define strhash_key(h,id) ((h)->keys[id])
+#define strhash_keyLen(h,id) ((h)->lens[id])
+#define strhash_count(h) ((h)->count)
+
+#endif
@@ -0,0 +1,339 @@
+#include "format.h"
+#include "log.h"
+#include "linereader.h"
+#include "arg.h"
+#include "strhash.h"
+#include "gct.h"
+#include "gctindex.h"
+
+#define AUTHOR_MAIL "roland.schmucki@roche.com"
+#define OUTPUT_BUFFER_SIZE 1048576
+
+
+void usagef (int level)
+{
+  romsg ("Description: \n"
+         "\n"
+         "Creates a subset of the input GCT file by using only specific samples \n"
+         "and/or features (keys) specified by input files. Rows and columns are \n"
+         "output in the order of the GCT file. \n"
+         "If the GCT file has an up to date row index (GCT_FILE.gcti, see gct_index), \n"
+         "only the rows of the keys are read instead of the whole file. \n"
+         "\n"
+         "Usage: %s [-k KEYS_FILE] [-s SAMPLES_FILE] [-gctb FILE] -g GCT_FILE \n"
+         "\n"
+         "Mandatory parameters: \n"
+         "\n"
+         "\t-g GCT_FILE      input GCT file, text or binary (.gctb, see gct2gctb) \n"
+         "\n"
+         "Optional parameters: \n"
+         "\n"
+         "\t-k KEYS_FILE     1st column: keys (e.g. genes) in input GCT file to output \n"
+         "\t-s SAMPLES_FILE  1st column: sample names in input GCT file to output \n"
+         "\t-gctb FILE       write the subset as binary GCT to FILE instead of the standard \n"
+         "\t                 output; values are float32, or of the input type for .gctb input \n"
+         "\n"
+         "Report bugs and feedback to %s \n",
+         arg_getProgName (),AUTHOR_MAIL);
+}
+
+
+
+/* length of the first tab-separated field of the len bytes at line */
+static int firstFieldLen (char *line,int len)
+{
+  char *tab = memchr (line,'\t',len);
+
+  return tab != NULL ? tab - line : len;
+}
+
+
+
+/* hash of the first tab-separated column of the lines of fileName */
+static StrHash readNames (char *fileName)
+{
+  StrHash names = strhash_create (1000);
+  LineReader ls;
+  char *line;
+  int len;
+
+  ls = lr_createFromFile (fileName);
+  while (line = lr_nextLineView (ls,&len)) {
+    len = firstFieldLen (line,len);
+    if (len > 0)
+      strhash_add (names,line,len);
+  }
+  lr_destroy (ls);
+  return names;
+}
+
+
+
+static GctIndex sortIndex;
+
+static int orderRowsByOffset (long *a,long *b)
+{
+  uint64_t oa = gcti_row (sortIndex,*a)->offset;
+  uint64_t ob = gcti_row (sortIndex,*b)->offset;
+
+  return oa < ob ? -1 : oa > ob;
+}
+
+
+
+/* rows of index x with an id in keys, in the order of the GCT file */
+static Array indexedRows (GctIndex x,StrHash keys)
+{
+  Array rows = arrayCreate (strhash_count (keys),long);
+  long first,count,i;
+  int id;
+
+  for (id=0;id<strhash_count (keys);id++) {
+    first = gcti_find (x,strhash_key (keys,id),strhash_keyLen (keys,id),&count);
+    for (i=0;i<count;i++)
+      array (rows,arrayMax (rows),long) = first + i;
+  }
+  sortIndex = x;
+  arraySort (rows,(ARRAYORDERF)orderRowsByOffset);
+  return rows;
+}
+
+
+
+/*
+  Finds the starts of the first n fields of the line ending at end (not
+  necessarily 0-terminated); returns the number found
+*/
+static int findFields (char *line,char *end,char **starts,int n)
+{
+  char *s = line;
+  int i = 0;
+
+  while (i < n) {
+    starts[i++] = s;
+    if ((s = memchr (s,'\t',end - s)) == NULL)
+      break;
+    s++;
+  }
+  return i;
+}
+
+
+
+/* writes field i of the line ending at end, given the field starts */
+static void writeField (FILE *fp,char **starts,int numFields,int i,char *end)
+{
+  char *start = starts[i];
+
+  if (i + 1 < numFields)
+    end = starts[i+1] - 1;
+  else
+    end = start + firstFieldLen (start,end - start);
+  fwrite (start,1,end - start,fp);
+}
+
+
+
+/* subset of the binary GCT fileName, as text GCT on stdout or as binary GCT to outFile */
+static void subsetGctb (char *fileName,StrHash keys,StrHash samples,char *outFile)
+{
+  Gctb in = gctb_open (fileName);
+  Texta sampleNames = textCreate (gctb_numCols (in));
+  Array gather = arrayCreate (gctb_numCols (in),long);  /* of long, columns to output */
+  double *values = hlr_malloc ((gctb_numCols (in) + 1) * sizeof (double));
+  double *outValues = hlr_malloc ((gctb_numCols (in) + 1) * sizeof (double));
+  char *id;
+  GctbWriter w = NULL;
+  GctOut out = NULL;
+  int numRows = 0;
+  long i,j;
+
+  for (j=0;j<gctb_numCols (in);j++)
+    if (samples == NULL ||
+        strhash_find (samples,gctb_colName (in,j),strlen (gctb_colName (in,j))) >= 0) {
+      array (gather,arrayMax (gather),long) = j;
+      textAdd (sampleNames,gctb_colName (in,j));
+    }
+  if (outFile != NULL)
+    w = gct_gctbWriter (outFile,sampleNames,in->header->type);
+  else
+    out = gct_outCreate (stdout,gctb_numRows (in),arrayMax (gather),gct_headerLine (sampleNames));
+  for (i=0;i<gctb_numRows (in);i++) {
+    id = gctb_rowId (in,i);
+    if (keys != NULL && strhash_find (keys,id,strlen (id)) < 0)
+      continue;
+    gctb_row (in,i,values);
+    for (j=0;j<arrayMax (gather);j++)
+      outValues[j] = values[arru (gather,j,long)];
+    if (w != NULL)
+      gctb_addRow (w,id,gctb_rowDesc (in,i),outValues);
+    else
+      gctb_printRow (gct_outRows (out),id,gctb_rowDesc (in,i),outValues,arrayMax (gather),
+                     in->header->type);
+    numRows++;
+  }
+  if (w != NULL)
+    gctb_finish (w);
+  else
+    gct_outFinish (out,numRows);
+  gctb_close (in);
+  hlr_free (values);
+  hlr_free (outValues);
+}
+
+
+
+int main (int argc,char *argv[])
+{
+  LineReader ls;
+  char *line,*s;
+  StrHash keys = NULL;
+  StrHash samples = NULL;
+  GctIndex index = NULL;
+  Array rows = NULL;         /* of long, index rows to read */
+  Stringa buffer = NULL;
+  Array gather;              /* of int, GCT fields to output after name and description */
+  char **starts = NULL;
+  int numStarts = 0;
+  int numFields;
+  Stringa line3 = stringCreate (10000);
+  GctOut out = NULL;
+  GctbWriter w = NULL;
+  Texta sampleNames;
+  double *values = NULL;
+  double *outValues = NULL;
+  char *desc;
+  Texta items;
+  int numValues = 0;
+  FILE *fp = NULL;
+  int maxRows = 0;
+  int numCols = 0;
+  int numRows = 0;
+  int len = 0;
+  int i,r = 0;
+
+  if (arg_init (argc,argv,"k,1 s,1 gctb,1","g",usagef) != argc)
+    die ("wrong number of arguments; invoke program without params for help");
+  if (arg_present ("k"))
+    keys = readNames (arg_get ("k"));
+  if (arg_present ("s"))
+    samples = readNames (arg_get ("s"));
+  setvbuf (stdout,NULL,_IOFBF,OUTPUT_BUFFER_SIZE);
+  if (gctb_isGctb (arg_get ("g"))) {
+    subsetGctb (arg_get ("g"),keys,samples,arg_present ("gctb") ? arg_get ("gctb") : NULL);
+    return 0;
+  }
+
+  ls = lr_createFromFile (arg_get ("g"));
+  while (line = lr_nextLine (ls)) {
+    if (lr_lineCountGet (ls) == 2) {
+      maxRows = atoi (line);
+      if ((s = strchr (line,'\t')) != NULL)
+        numCols = atoi (s + 1);
+    }
+    if (lr_lineCountGet (ls) == 3)
+      break;
+  }
+  if (line == NULL)
+    die ("%s: GCT header with less than 3 lines",arg_get ("g"));
+  if (keys != NULL && (index = gcti_open (arg_get ("g"))) != NULL) {
+    rows = indexedRows (index,keys);
+    maxRows = arrayMax (rows);
+    buffer = stringCreate (10000);
+  }
+
+  /* column gather map from the header, resolved once */
+  gather = arrayCreate (100,int);
+  if (samples != NULL) {
+    numStarts = 0;
+    for (s=line;s!=NULL;s=strchr (s + 1,'\t'))
+      numStarts++;
+    starts = hlr_malloc (numStarts * sizeof (char *));
+    numFields = findFields (line,line + strlen (line),starts,numStarts);
+    for (i=0;i<2 && i<numFields;i++) {
+      if (i > 0)
+        stringCatChar (line3,'\t');
+      stringAppendf (line3,"%.*s",(int)strcspn (starts[i],"\t"),starts[i]);
+    }
+    for (i=2;i<numFields;i++)
+      if (strhash_find (samples,starts[i],strcspn (starts[i],"\t")) >= 0) {
+        array (gather,arrayMax (gather),int) = i;
+        stringAppendf (line3,"\t%.*s",(int)strcspn (starts[i],"\t"),starts[i]);
+      }
+    numCols = arrayMax (gather);
+    /* only the fields up to the last gathered one are located per row */
+    numStarts = arrayMax (gather) > 0 ? arru (gather,arrayMax (gather) - 1,int) + 1 : 2;
+  }
+  else
+    stringCpy (line3,line);
+  if (arg_present ("gctb")) {
+    /* the values of the whole row are parsed, then gathered */
+    sampleNames = textCreate (100);
+    items = textFieldtokP (line,"\t");
+    for (i=2;i<arrayMax (items);i++)
+      if (samples == NULL || strhash_find (samples,textItem (items,i),strlen (textItem (items,i))) >= 0)
+        textAdd (sampleNames,textItem (items,i));
+    w = gct_gctbWriter (arg_get ("gctb"),sampleNames,GCTB_FLOAT32);
+    numValues = arrayMax (items) - 2;
+    values = hlr_malloc ((numValues + 1) * sizeof (double));
+    outValues = hlr_malloc ((numValues + 1) * sizeof (double));
+  }
+  else {
+    out = gct_outCreate (stdout,maxRows,numCols,string (line3));
+    fp = gct_outRows (out);
+  }
+
+  for (;;) {
+    if (rows != NULL) {
+      if (r == arrayMax (rows))
+        break;
+      line = gcti_readRow (index,arru (rows,r++,long),buffer);
+      len = strlen (line);
+    }
+    else {
+      /* text output only reads the row, so it is used in place */
+      if ((line = w != NULL ? lr_nextLine (ls) : lr_nextLineView (ls,&len)) == NULL)
+        break;
+      if (w != NULL)
+        len = strlen (line);
+      if (keys != NULL && strhash_find (keys,line,firstFieldLen (line,len)) < 0)
+        continue;
+    }
+    numRows++;
+    if (w != NULL) {
+      gct_splitRow (line,&desc,&s);
+      gct_parseValues (s,values,numValues,arg_get ("g"),line);
+      if (samples == NULL)
+        gctb_addRow (w,line,desc,values);
+      else {
+        for (i=0;i<arrayMax (gather);i++)
+          outValues[i] = values[arru (gather,i,int) - 2];
+        gctb_addRow (w,line,desc,outValues);
+      }
+      continue;
+    }
+    if (samples == NULL) {
+      fwrite (line,1,len,fp);
+      putc ('\n',fp);
+      continue;
+    }
+    numFields = findFields (line,line + len,starts,numStarts);
+    writeField (fp,starts,numFields,0,line + len);
+    putc ('\t',fp);
+    if (numFields > 1)
+      writeField (fp,starts,numFields,1,line + len);
+    for (i=0;i<arrayMax (gather);i++) {
+      putc ('\t',fp);
+      if (arru (gather,i,int) < numFields)
+        writeField (fp,starts,numFields,arru (gather,i,int),line + len);
+    }
+    putc ('\n',fp);
+  }
+  lr_destroy (ls);
+  gcti_close (index);
+  if (w != NULL)
+    gctb_finish (w);
+  else
+    gct_outFinish (out,numRows);
+  return 0;
+}
@@ -0,0 +1,385 @@
+#include <unistd.h>
+#include <stdint.h>
+#include "format.h"
+#include "log.h"
+#include "linereader.h"
+#include "arg.h"
+#include "gct.h"
+
+#define AUTHOR_MAIL "roland.schmucki@roche.com"
+#define OUTPUT_BUFFER_SIZE 1048576
+#define COPY_BUFFER_SIZE 1048576
+#define COL_BLOCK 256    /* columns scattered at once, their write positions stay in cache */
+
+
+void usagef (int level)
+{
+  romsg ("Description: \n"
+         "\n"
+         "Transposes a GCT file: samples become rows and features become columns. \n"
+         "Values are copied verbatim; the descriptions of the output rows are na. \n"
+         "Rows are read in blocks that fit into -memory and each block is transposed \n"
+         "in memory; if the file does not fit, the transposed blocks are written to a \n"
+         "temporary file and the output is assembled from it in one sweep. \n"
+         "A binary GCT (.gctb, see gct2gctb) is read in place, -memory columns at a time. \n"
+         "With -gctb the input rows become the columns of a column-major binary GCT, \n"
+         "written as they are read, without a temporary file. \n"
+         "\n"
+         "Usage: %s [-memory MB] [-tmpdir DIR] [-gctb FILE] -g GCT_FILE \n"
+         "\n"
+         "Mandatory parameters: \n"
+         "\n"
+         "\t-g GCT_FILE  input GCT file (- for stdin), text or binary (.gctb) \n"
+         "\n"
+         "Optional parameters: \n"
+         "\n"
+         "\t-memory MB   memory for the rows transposed at once (default: 1024) \n"
+         "\t-tmpdir DIR  directory for the temporary file (default: $TMPDIR or /tmp) \n"
+         "\t-gctb FILE   write the result as binary GCT to FILE instead of the standard \n"
+         "\t             output; values are float32, or of the input type for .gctb input \n"
+         "\n"
+         "Report bugs and feedback to %s \n",
+         arg_getProgName (),AUTHOR_MAIL);
+}
+
+
+
+/*
+  Rows of the current block: the lines in arena and per row numCols + 1
+  value starts, relative to the line; value j of a row spans
+  starts[j] .. starts[j+1] - 2
+*/
+static char *arena;
+static Array lines;      /* of char *, into arena */
+static Array starts;     /* of uint32_t */
+static int numCols;
+
+
+
+/* value starts of line, appended to starts; dies if the count is wrong */
+static void addStarts (char *line)
+{
+  char *s = line;
+  int i;
+
+  for (i=0;i<2;i++)
+    if ((s = strchr (s,'\t')) == NULL)
+      die ("GCT row without values: %s",line);
+    else
+      s++;
+  for (i=0;i<numCols;i++) {
+    array (starts,arrayMax (starts),uint32_t) = s - line;
+    if ((s = strchr (s,'\t')) == NULL) {
+      s = line + strlen (line);
+      if (i + 1 < numCols)
+        die ("GCT row with %d values, expected %d: %.*s",i + 1,numCols,
+             (int)strcspn (line,"\t"),line);
+    }
+    s++;
+  }
+  if (s[-1] != '\0')
+    die ("GCT row with more than %d values: %.*s",numCols,(int)strcspn (line,"\t"),line);
+  array (starts,arrayMax (starts),uint32_t) = s - line;
+}
+
+
+
+/*
+  Transposes the rows of the block into tile: per column the values of
+  all rows, each preceded by a tab; colOffsets (numCols + 1 entries)
+  receives the start of each column in tile, colOffsets[numCols] its size
+*/
+static void transposeBlock (char **tile,size_t *tileSize,uint64_t *colOffsets)
+{
+  int numRows = arrayMax (lines);
+  char **pos = hlr_malloc (numCols * sizeof (char *));
+  uint32_t *st;
+  char *line;
+  int r,j,jEnd,b,len;
+
+  /* column lengths, then their offsets */
+  for (j=0;j<=numCols;j++)
+    colOffsets[j] = 0;
+  for (r=0;r<numRows;r++) {
+    st = arrp (starts,r * (numCols + 1),uint32_t);
+    for (j=0;j<numCols;j++)
+      colOffsets[j+1] += st[j+1] - st[j];
+  }
+  for (j=0;j<numCols;j++)
+    colOffsets[j+1] += colOffsets[j];
+  if (colOffsets[numCols] > *tileSize) {
+    hlr_free (*tile);
+    *tileSize = colOffsets[numCols];
+    *tile = hlr_malloc (*tileSize);
+  }
+
+  /* scatter in blocks of columns so that the write positions stay in cache */
+  for (b=0;b<numCols;b+=COL_BLOCK) {
+    jEnd = b + COL_BLOCK < numCols ? b + COL_BLOCK : numCols;
+    for (j=b;j<jEnd;j++)
+      pos[j] = *tile + colOffsets[j];
+    for (r=0;r<numRows;r++) {
+      line = arru (lines,r,char *);
+      st = arrp (starts,r * (numCols + 1),uint32_t);
+      for (j=b;j<jEnd;j++) {
+        len = st[j+1] - st[j] - 1;
+        *pos[j]++ = '\t';
+        memcpy (pos[j],line + st[j],len);
+        pos[j] += len;
+      }
+    }
+  }
+  hlr_free (pos);
+}
+
+
+
+static void writeAll (int fd,char *data,size_t size)
+{
+  ssize_t n;
+
+  while (size > 0) {
+    if ((n = write (fd,data,size)) <= 0)
+      die ("error writing temporary file");
+    data += n;
+    size -= n;
+  }
+}
+
+
+
+static void copyRange (int fd,off_t offset,size_t size,char *buffer)
+{
+  ssize_t n;
+
+  while (size > 0) {
+    n = pread (fd,buffer,size < COPY_BUFFER_SIZE ? size : COPY_BUFFER_SIZE,offset);
+    if (n <= 0)
+      die ("error reading temporary file");
+    fwrite (buffer,1,n,stdout);
+    offset += n;
+    size -= n;
+  }
+}
+
+
+
+/*
+  Transposes the binary GCT fileName to stdout. Row-major values are
+  gathered for as many columns at once as fit into memory bytes
+*/
+static void transposeGctb (char *fileName,size_t memory)
+{
+  Gctb in = gctb_open (fileName);
+  long numRows = gctb_numRows (in);
+  long numIn = gctb_numCols (in);
+  double *values = hlr_malloc ((numIn + 1) * sizeof (double));
+  double *block;
+  long blockCols,b,bEnd,i,j;
+
+  printf ("#1.2\n%ld\t%ld\nName\tDescription",numIn,numRows);
+  for (i=0;i<numRows;i++)
+    printf ("\t%s",gctb_rowId (in,i));
+  putchar ('\n');
+  blockCols = memory / ((numRows + 1) * sizeof (double));
+  if (in->header->layout == GCTB_COL_MAJOR || blockCols < 1)
+    blockCols = 1;
+  block = hlr_malloc ((blockCols * numRows + 1) * sizeof (double));
+  for (b=0;b<numIn;b+=blockCols) {
+    bEnd = b + blockCols < numIn ? b + blockCols : numIn;
+    if (in->header->layout == GCTB_COL_MAJOR)
+      for (i=0;i<numRows;i++)
+        block[i] = gctb_value (in,i,b);
+    else
+      for (i=0;i<numRows;i++) {
+        gctb_row (in,i,values);
+        for (j=b;j<bEnd;j++)
+          block[(j - b) * numRows + i] = values[j];
+      }
+    for (j=b;j<bEnd;j++)
+      gctb_printRow (stdout,gctb_colName (in,j),"na",block + (j - b) * numRows,numRows,
+                     in->header->type);
+  }
+  hlr_free (block);
+  hlr_free (values);
+  gctb_close (in);
+}
+
+
+
+/*
+  Transposes GCT file fileName, text or binary, to the binary GCT
+  outFile: the input rows are added as the columns of a column-major
+  matrix
+*/
+static void transposeToGctb (char *fileName,char *outFile)
+{
+  Gctb in;
+  LineReader ls;
+  GctbWriter w;
+  Texta sampleNames;
+  char *line,*desc,*s;
+  double *values;
+  long i,j;
+
+  if (gctb_isGctb (fileName)) {
+    in = gctb_open (fileName);
+    w = gctb_createWriter (outFile,gctb_numCols (in),gctb_numRows (in),in->header->type,
+                           GCTB_COL_MAJOR);
+    for (j=0;j<gctb_numCols (in);j++)
+      gctb_setRowName (w,j,gctb_colName (in,j),"na");
+    values = hlr_malloc ((gctb_numCols (in) + 1) * sizeof (double));
+    for (i=0;i<gctb_numRows (in);i++) {
+      gctb_row (in,i,values);
+      gctb_addCol (w,gctb_rowId (in,i),values);
+    }
+    gctb_close (in);
+  }
+  else {
+    ls = lr_createFromFile (fileName);
+    sampleNames = gct_readHeader (ls,NULL);
+    w = gctb_createWriter (outFile,arrayMax (sampleNames),-1,GCTB_FLOAT32,GCTB_COL_MAJOR);
+    for (j=0;j<arrayMax (sampleNames);j++)
+      gctb_setRowName (w,j,textItem (sampleNames,j),"na");
+    values = hlr_malloc ((arrayMax (sampleNames) + 1) * sizeof (double));
+    while (line = lr_nextLine (ls)) {
+      if (*line == '\0')
+        continue;
+      gct_splitRow (line,&desc,&s);
+      gct_parseValues (s,values,arrayMax (sampleNames),fileName,line);
+      gctb_addCol (w,line,values);
+    }
+    lr_destroy (ls);
+  }
+  gctb_finish (w);
+  hlr_free (values);
+}
+
+
+
+int main (int argc,char *argv[])
+{
+  LineReader ls;
+  char *line;
+  Texta sampleNames;
+  Stringa ids = stringCreate (100000);
+  size_t arenaSize,used,len,rowSize;
+  int lineLen;
+  char *tile = NULL;
+  size_t tileSize = 0;
+  Array tileOffsets = arrayCreate (10,uint64_t);   /* per spilled block, numCols + 1 column offsets */
+  Array tileStarts = arrayCreate (10,uint64_t);    /* per spilled block, its offset in the temporary file */
+  uint64_t *colOffsets;
+  uint64_t *offsets;
+  Stringa tmpName = stringCreate (100);
+  char *tmpDir;
+  char *buffer;
+  off_t spilled = 0;
+  int fd = -1;
+  int numTiles,t,j;
+  long numOut = 0;
+  char *tab;
+
+  if (arg_init (argc,argv,"memory,1 tmpdir,1 gctb,1","g",usagef) != argc)
+    die ("wrong number of arguments; invoke program without params for help");
+  arenaSize = ((size_t)(arg_present ("memory") ? atoi (arg_get ("memory")) : 1024) << 20) / 3;
+  if (arenaSize == 0)
+    die ("-memory must be at least 1");
+  if (arg_present ("tmpdir"))
+    tmpDir = arg_get ("tmpdir");
+  else if ((tmpDir = getenv ("TMPDIR")) == NULL)
+    tmpDir = "/tmp";
+  setvbuf (stdout,NULL,_IOFBF,OUTPUT_BUFFER_SIZE);
+  if (arg_present ("gctb")) {
+    transposeToGctb (arg_get ("g"),arg_get ("gctb"));
+    return 0;
+  }
+  if (gctb_isGctb (arg_get ("g"))) {
+    transposeGctb (arg_get ("g"),arenaSize * 3);
+    if (fflush (stdout) != 0)
+      die ("error writing output");
+    return 0;
+  }
+
+  ls = lr_createFromFile (arg_get ("g"));
+  sampleNames = gct_readHeader (ls,NULL);
+  numCols = arrayMax (sampleNames);
+  colOffsets = hlr_malloc ((numCols + 1) * sizeof (uint64_t));
+  /*
+    the rows and their value starts take at most a third of -memory each
+    (both are counted against arenaSize), their transpose is not larger
+  */
+  arena = hlr_malloc (arenaSize);
+  lines = arrayCreate (10000,char *);
+  starts = arrayCreate (10000 * (numCols + 1),uint32_t);
+  rowSize = (numCols + 1) * sizeof (uint32_t) + sizeof (char *);
+  used = 0;
+  for (;;) {
+    /* the rows are copied into the arena straight from the input */
+    line = lr_nextLineView (ls,&lineLen);
+    len = line != NULL ? lineLen + 1 : 0;
+    if (line != NULL && len == 1)
+      continue;
+    if (line == NULL || (used + len + rowSize > arenaSize && arrayMax (lines) > 0)) {
+      transposeBlock (&tile,&tileSize,colOffsets);
+      if (line == NULL && fd == -1)
+        break;  /* everything fits: the output is written from the tile */
+      if (fd == -1) {
+        stringPrintf (tmpName,"%s/transpose_gct.XXXXXX",tmpDir);
+        if ((fd = mkstemp (string (tmpName))) == -1)
+          die ("cannot create temporary file in %s",tmpDir);
+        unlink (string (tmpName));
+      }
+      array (tileStarts,arrayMax (tileStarts),uint64_t) = spilled;
+      for (j=0;j<=numCols;j++)
+        array (tileOffsets,arrayMax (tileOffsets),uint64_t) = colOffsets[j];
+      writeAll (fd,tile,colOffsets[numCols]);
+      spilled += colOffsets[numCols];
+      arrayClear (lines);
+      arrayClear (starts);
+      used = 0;
+      if (line == NULL)
+        break;
+    }
+    if (len + rowSize > arenaSize)
+      die ("line %d is longer than -memory",lr_lineCountGet (ls));
+    line = memcpy (arena + used,line,lineLen);
+    line[lineLen] = '\0';
+    array (lines,arrayMax (lines),char *) = line;
+    addStarts (line);
+    used += len + rowSize;
+    tab = strchr (line,'\t');
+    stringCatChar (ids,'\t');
+    stringAppendf (ids,"%.*s",(int)(tab - line),line);
+    numOut++;
+  }
+  lr_destroy (ls);
+  hlr_free (arena);
+
+  printf ("#1.2\n%d\t%ld\nName\tDescription%s\n",numCols,numOut,string (ids));
+  if (fd == -1) {
+    for (j=0;j<numCols;j++) {
+      printf ("%s\tna",textItem (sampleNames,j));
+      fwrite (tile + colOffsets[j],1,colOffsets[j+1] - colOffsets[j],stdout);
+      putchar ('\n');
+    }
+  }
+  else {
+    /* one sweep over the output; each block of the temporary file is read in order */
+    buffer = hlr_malloc (COPY_BUFFER_SIZE);
+    numTiles = arrayMax (tileStarts);
+    for (j=0;j<numCols;j++) {
+      printf ("%s\tna",textItem (sampleNames,j));
+      for (t=0;t<numTiles;t++) {
+        offsets = arrp (tileOffsets,t * (numCols + 1),uint64_t);
+        copyRange (fd,arru (tileStarts,t,uint64_t) + offsets[j],offsets[j+1] - offsets[j],buffer);
+      }
+      putchar ('\n');
+    }
+    hlr_free (buffer);
+    close (fd);
+  }
+  if (fflush (stdout) != 0)
+    die ("error writing output");
+  return 0;
+}